@@ -0,0 +1,126 @@
+#include "Arena.h"
+
+#include <stdint.h>
+
+
+#ifdef _DEBUG
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#else
+#include <malloc.h>
+#endif
+
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK_SIZE 4096
+
+#define ARENA_ALIGN(x) (((x) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+
+static PARENA_BLOCK AllocBlock(size_t size) {
+	size_t headerSize = ARENA_ALIGN(sizeof(ARENA_BLOCK));
+
+	if (size > SIZE_MAX - headerSize - ARENA_ALIGNMENT) {
+		return NULL;
+	}
+
+	// malloc only guarantees 8-byte alignment on 32-bit targets, so the
+	// data start is aligned by hand inside the block.
+	PARENA_BLOCK block = (PARENA_BLOCK)malloc(headerSize + size + ARENA_ALIGNMENT);
+
+	if (block == NULL) {
+		return NULL;
+	}
+
+	block->Next = NULL;
+	block->Size = size;
+	block->Used = 0;
+
+	return block;
+}
+
+
+static PBYTE BlockData(PARENA_BLOCK block) {
+	size_t address = (size_t)block + ARENA_ALIGN(sizeof(ARENA_BLOCK));
+	return (PBYTE)ARENA_ALIGN(address);
+}
+
+
+HRESULT CreateArena(size_t reserve, PARENA* result) {
+	size_t arenaSize = ARENA_ALIGN(sizeof(ARENA));
+
+	if (reserve > SIZE_MAX - arenaSize) {
+		return E_OUTOFMEMORY;
+	}
+
+	size_t blockSize = max(ARENA_MIN_BLOCK_SIZE, arenaSize + reserve);
+
+	PARENA_BLOCK block = AllocBlock(blockSize);
+
+	if (block == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	// The arena itself is the first allocation of its first block
+	PARENA arena = (PARENA)BlockData(block);
+
+	block->Used = arenaSize;
+
+	arena->First = block;
+	arena->Current = block;
+	arena->BlockSize = ARENA_MIN_BLOCK_SIZE;
+
+	*result = arena;
+
+	return S_OK;
+}
+
+
+VOID FreeArena(PARENA arena) {
+	PARENA_BLOCK block = arena->First;
+
+	while (block) {
+		PARENA_BLOCK next = block->Next;
+		free(block);
+		block = next;
+	}
+}
+
+
+PVOID ArenaAlloc(PARENA arena, size_t size) {
+	if (size > SIZE_MAX - ARENA_ALIGNMENT) {
+		return NULL;
+	}
+
+	size = ARENA_ALIGN(size);
+
+	PARENA_BLOCK block = arena->Current;
+
+	if (block->Size - block->Used < size) {
+		// The up-front estimate was too small, chain another block with
+		// room for the small allocations that usually follow
+		if (size > SIZE_MAX - arena->BlockSize) {
+			return NULL;
+		}
+
+		block = AllocBlock(size + arena->BlockSize);
+
+		if (block == NULL) {
+			return NULL;
+		}
+
+		block->Next = arena->Current->Next;
+		arena->Current->Next = block;
+		arena->Current = block;
+
+		if (arena->BlockSize < 0x100000) {
+			arena->BlockSize *= 2;
+		}
+	}
+
+	PVOID memory = BlockData(block) + block->Used;
+	block->Used += size;
+
+	return memory;
+}
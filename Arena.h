@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Windows.h>
+
+
+struct ARENA_BLOCK {
+	ARENA_BLOCK* Next;
+	size_t Size;
+	size_t Used;
+};
+
+typedef ARENA_BLOCK* PARENA_BLOCK;
+
+
+// Bump allocator backing a single parsed sprite. Allocations are never
+// freed individually, FreeArena releases all blocks at once.
+struct ARENA {
+	PARENA_BLOCK First;
+	PARENA_BLOCK Current;
+	size_t BlockSize;
+};
+
+typedef ARENA* PARENA;
+
+
+// The first block is sized to hold `reserve` bytes of allocations, further
+// blocks are only created when that estimate was too small.
+HRESULT CreateArena(size_t reserve, PARENA* result);
+
+VOID FreeArena(PARENA arena);
+
+// Returns 16-byte aligned, uninitialized memory or NULL.
+PVOID ArenaAlloc(PARENA arena, size_t size);
@@ -0,0 +1,369 @@
+#include "Bc7Decode.h"
+
+
+// Layout of one mode: subsets, partition, rotation and index selection
+// bits, bits per color and alpha endpoint channel, p-bits per endpoint or
+// per subset, and the bits of the primary and the secondary index.
+struct BC7_MODE {
+	INT32 Subsets;
+	INT32 PartitionBits;
+	INT32 RotationBits;
+	INT32 IndexSelectionBits;
+	INT32 ColorBits;
+	INT32 AlphaBits;
+	INT32 EndpointPBits;
+	INT32 SharedPBits;
+	INT32 IndexBits;
+	INT32 SecondaryIndexBits;
+};
+
+
+static const BC7_MODE g_modes[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+
+// Two subset partitions, bit i set when pixel i is in subset 1.
+static const UINT16 g_partitions2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+
+// Three subset partitions, subset of every pixel.
+static const BYTE g_partitions3[64][16] = {
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+	{ 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+	{ 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+	{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+	{ 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+	{ 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+	{ 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+	{ 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+	{ 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+	{ 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+	{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+	{ 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+	{ 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+	{ 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+	{ 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+	{ 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+	{ 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+	{ 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+	{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+	{ 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+	{ 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+	{ 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+	{ 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+	{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+	{ 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+	{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+	{ 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+	{ 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+	{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+	{ 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+	{ 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+	{ 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+	{ 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+	{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+};
+
+
+// Anchor pixel of subset 1 of the two subset partitions, and of subsets 1
+// and 2 of the three subset ones. Pixel 0 anchors subset 0.
+static const BYTE g_anchors2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+static const BYTE g_anchors3[2][64] = {
+	{
+		 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+		 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+		 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+		 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+	},
+	{
+		15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+		15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+		15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+		15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+	}
+};
+
+
+// Interpolation weights out of 64 for 2, 3 and 4-bit indices.
+static const BYTE g_weights2[4] = { 0, 21, 43, 64 };
+static const BYTE g_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const BYTE g_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+static const BYTE* GetWeights(INT32 indexBits) {
+	switch (indexBits) {
+		case 2: {
+			return g_weights2;
+		}
+		case 3: {
+			return g_weights3;
+		}
+	}
+
+	return g_weights4;
+}
+
+
+// The unread bits of a block, the next field is always at the bottom.
+struct BC7_BITS {
+	UINT64 Low;
+	UINT64 High;
+};
+
+
+static UINT32 ReadBits(BC7_BITS* bits, INT32 count) {
+	if (count == 0) {
+		return 0;
+	}
+
+	UINT32 value = (UINT32)(bits->Low & ((1ull << count) - 1));
+
+	bits->Low = (bits->Low >> count) | (bits->High << (64 - count));
+	bits->High >>= count;
+
+	return value;
+}
+
+
+// Widens a channel to 8 bits by repeating its top bits, bits is at least 5.
+static BYTE ExpandChannel(UINT32 value, INT32 bits) {
+	return (BYTE)((value << (8 - bits)) | (value >> (2 * bits - 8)));
+}
+
+
+static BYTE Interpolate(BYTE e0, BYTE e1, INT32 weight) {
+	return (BYTE)(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+
+// Endpoint as four 16-bit lanes B, G, R, A, so one multiply-add covers all
+// channels. 64 * 255 + 32 still fits a lane.
+static UINT64 ToLanes(const BYTE color[4]) {
+	return (UINT64)color[2] | ((UINT64)color[1] << 16) | ((UINT64)color[0] << 32) | ((UINT64)color[3] << 48);
+}
+
+
+static UINT32 InterpolateLanes(UINT64 e0, UINT64 e1, INT32 weight) {
+	UINT64 lanes = ((e0 * (UINT64)(64 - weight) + e1 * (UINT64)weight + 0x0020002000200020ull) >> 6) & 0x00FF00FF00FF00FFull;
+
+	lanes = (lanes | (lanes >> 8)) & 0x0000FFFF0000FFFFull;
+
+	return (UINT32)(lanes | (lanes >> 16));
+}
+
+
+VOID DecodeBC7Block(const BYTE* block, UINT32 pixels[16]) {
+	// The mode is the number of zero bits before the first set bit
+	INT32 mode = 0;
+
+	while (mode < 8 && !(block[0] & (1 << mode))) {
+		mode++;
+	}
+
+	if (mode == 8) {
+		memset(pixels, 0, sizeof(UINT32) * 16);
+		return;
+	}
+
+	const BC7_MODE* info = &g_modes[mode];
+
+	BC7_BITS bits;
+	memcpy(&bits.Low, block, sizeof(UINT64));
+	memcpy(&bits.High, block + 8, sizeof(UINT64));
+
+	ReadBits(&bits, mode + 1);
+
+	INT32 partition = (INT32)ReadBits(&bits, info->PartitionBits);
+	INT32 rotation = (INT32)ReadBits(&bits, info->RotationBits);
+	INT32 indexSelection = (INT32)ReadBits(&bits, info->IndexSelectionBits);
+
+	//
+	// Endpoints, two per subset as R, G, B, A
+	//
+
+	INT32 endpointCount = info->Subsets * 2;
+	UINT32 endpoints[6][4];
+
+	for (INT32 channel = 0; channel < 3; channel++) {
+		for (INT32 i = 0; i < endpointCount; i++) {
+			endpoints[i][channel] = ReadBits(&bits, info->ColorBits);
+		}
+	}
+
+	for (INT32 i = 0; i < endpointCount; i++) {
+		endpoints[i][3] = ReadBits(&bits, info->AlphaBits);
+	}
+
+	INT32 colorBits = info->ColorBits;
+	INT32 alphaBits = info->AlphaBits;
+
+	// A p-bit is the shared lowest bit of all channels of an endpoint
+	if (info->EndpointPBits || info->SharedPBits) {
+		for (INT32 i = 0; i < endpointCount; i++) {
+			UINT32 pbit = (info->SharedPBits && (i & 1)) ? endpoints[i - 1][0] & 1 : ReadBits(&bits, 1);
+
+			for (INT32 channel = 0; channel < 4; channel++) {
+				endpoints[i][channel] = (endpoints[i][channel] << 1) | pbit;
+			}
+		}
+
+		colorBits++;
+		alphaBits = alphaBits ? alphaBits + 1 : 0;
+	}
+
+	BYTE colors[6][4];
+
+	for (INT32 i = 0; i < endpointCount; i++) {
+		colors[i][0] = ExpandChannel(endpoints[i][0], colorBits);
+		colors[i][1] = ExpandChannel(endpoints[i][1], colorBits);
+		colors[i][2] = ExpandChannel(endpoints[i][2], colorBits);
+		colors[i][3] = alphaBits ? ExpandChannel(endpoints[i][3], alphaBits) : 255;
+	}
+
+	//
+	// Indices, the anchor pixel of each subset has its top bit left out
+	//
+
+	INT32 anchor1 = 0;
+	INT32 anchor2 = 0;
+
+	if (info->Subsets == 2) {
+		anchor1 = g_anchors2[partition];
+	}
+	else if (info->Subsets == 3) {
+		anchor1 = g_anchors3[0][partition];
+		anchor2 = g_anchors3[1][partition];
+	}
+
+	BYTE subsets[16];
+	BYTE indices[16];
+
+	for (INT32 i = 0; i < 16; i++) {
+		INT32 subset = 0;
+
+		if (info->Subsets == 2) {
+			subset = (g_partitions2[partition] >> i) & 1;
+		}
+		else if (info->Subsets == 3) {
+			subset = g_partitions3[partition][i];
+		}
+
+		BOOL anchor = i == 0 || (subset != 0 && (i == anchor1 || i == anchor2));
+
+		subsets[i] = (BYTE)subset;
+		indices[i] = (BYTE)ReadBits(&bits, info->IndexBits - anchor);
+	}
+
+	//
+	// One palette per subset, then a lookup per pixel
+	//
+
+	if (info->SecondaryIndexBits == 0) {
+		const BYTE* weights = GetWeights(info->IndexBits);
+		INT32 entries = 1 << info->IndexBits;
+
+		UINT32 palette[3][16];
+
+		for (INT32 subset = 0; subset < info->Subsets; subset++) {
+			UINT64 e0 = ToLanes(colors[subset * 2]);
+			UINT64 e1 = ToLanes(colors[subset * 2 + 1]);
+
+			for (INT32 i = 0; i < entries; i++) {
+				palette[subset][i] = InterpolateLanes(e0, e1, weights[i]);
+			}
+		}
+
+		for (INT32 i = 0; i < 16; i++) {
+			pixels[i] = palette[subsets[i]][indices[i]];
+		}
+
+		return;
+	}
+
+	// Modes 4 and 5, separate color and alpha indices, the index selection
+	// bit of mode 4 swaps which of the two the colors use.
+	BYTE secondary[16];
+
+	for (INT32 i = 0; i < 16; i++) {
+		secondary[i] = (BYTE)ReadBits(&bits, info->SecondaryIndexBits - (i == 0));
+	}
+
+	const BYTE* colorIndices = indexSelection ? secondary : indices;
+	const BYTE* alphaIndices = indexSelection ? indices : secondary;
+	const BYTE* colorWeights = GetWeights(indexSelection ? info->SecondaryIndexBits : info->IndexBits);
+	const BYTE* alphaWeights = GetWeights(indexSelection ? info->IndexBits : info->SecondaryIndexBits);
+
+	for (INT32 i = 0; i < 16; i++) {
+		INT32 colorWeight = colorWeights[colorIndices[i]];
+		INT32 alphaWeight = alphaWeights[alphaIndices[i]];
+
+		BYTE pixel[4] = {
+			Interpolate(colors[0][0], colors[1][0], colorWeight),
+			Interpolate(colors[0][1], colors[1][1], colorWeight),
+			Interpolate(colors[0][2], colors[1][2], colorWeight),
+			Interpolate(colors[0][3], colors[1][3], alphaWeight)
+		};
+
+		// Rotation 1, 2 or 3 swaps alpha with red, green or blue
+		if (rotation) {
+			BYTE alpha = pixel[3];
+			pixel[3] = pixel[rotation - 1];
+			pixel[rotation - 1] = alpha;
+		}
+
+		pixels[i] = (UINT32)pixel[2] | ((UINT32)pixel[1] << 8) | ((UINT32)pixel[0] << 16) | ((UINT32)pixel[3] << 24);
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// Decodes one 16 byte BC7 block to 16 pixels of 32-bit B, G, R, A in row
+// order, straight alpha. Blocks of the reserved mode 8 are transparent black.
+VOID DecodeBC7Block(const BYTE* block, UINT32 pixels[16]);
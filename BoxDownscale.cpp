@@ -0,0 +1,331 @@
+#include "BoxDownscale.h"
+#include "CpuFeatures.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define BOX_DOWNSCALE_SIMD
+#include <immintrin.h>
+#endif
+
+
+// Alpha weighted sums of this many pixels stay below 2^31, so they also
+// convert to float as signed integers
+#define BOX_MAX_PIXELS 32768
+
+
+// Adds one source row to the sums of an output pixel: B*A, G*A, R*A, A and
+// then B, G, R, A unweighted. The unweighted colors are used where the whole
+// block is transparent, like the stb resizer keeps the color of such areas.
+typedef VOID(*BOX_SUM_ROW)(const BYTE* src, INT32 newWidth, INT32 factor, UINT32* sums);
+
+// Turns the sums of count pixels into one output row.
+typedef VOID(*BOX_RESOLVE_ROW)(const UINT32* sums, INT32 newWidth, UINT32 count, BYTE* dst);
+
+
+//
+// Scalar
+//
+
+static VOID SumRowScalar(const BYTE* src, INT32 newWidth, INT32 factor, UINT32* sums) {
+	for (INT32 x = 0; x < newWidth; x++) {
+		for (INT32 i = 0; i < factor; i++) {
+			UINT32 alpha = src[3];
+
+			sums[0] += src[0] * alpha;
+			sums[1] += src[1] * alpha;
+			sums[2] += src[2] * alpha;
+			sums[3] += alpha;
+			sums[4] += src[0];
+			sums[5] += src[1];
+			sums[6] += src[2];
+			sums[7] += alpha;
+
+			src += 4;
+		}
+
+		sums += 8;
+	}
+}
+
+
+// The float math matches the SIMD kernels bit for bit
+static VOID ResolveRowScalar(const UINT32* sums, INT32 newWidth, UINT32 count, BYTE* dst) {
+	for (INT32 x = 0; x < newWidth; x++) {
+		UINT32 alpha = sums[3];
+		const UINT32* colors = sums;
+		UINT32 divisor = alpha;
+
+		if (alpha == 0) {
+			colors = sums + 4;
+			divisor = count;
+		}
+
+		dst[0] = (BYTE)(INT32)((float)(INT32)colors[0] / (float)(INT32)divisor + 0.5f);
+		dst[1] = (BYTE)(INT32)((float)(INT32)colors[1] / (float)(INT32)divisor + 0.5f);
+		dst[2] = (BYTE)(INT32)((float)(INT32)colors[2] / (float)(INT32)divisor + 0.5f);
+		dst[3] = (BYTE)(INT32)((float)(INT32)alpha / (float)(INT32)count + 0.5f);
+
+		sums += 8;
+		dst += 4;
+	}
+}
+
+
+#ifdef BOX_DOWNSCALE_SIMD
+
+//
+// SSE2
+//
+
+// Sums of the two pixels in the low 8 bytes. Their channels are interleaved
+// so one madd multiplies each color by its alpha and adds the pair, the
+// alpha lanes are multiplied by 1. A second madd adds them unweighted.
+static VOID SumPairSSE2(__m128i pixels, __m128i* weighted, __m128i* plain) {
+	const __m128i colorMask = _mm_set_epi32(0, -1, -1, -1);
+	const __m128i alphaOne = _mm_set_epi32(0x00010001, 0, 0, 0);
+
+	__m128i pairs = _mm_unpacklo_epi8(pixels, _mm_srli_si128(pixels, 4));
+	__m128i words = _mm_unpacklo_epi8(pairs, _mm_setzero_si128());
+	__m128i alpha = _mm_shuffle_epi32(words, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i weights = _mm_or_si128(_mm_and_si128(alpha, colorMask), alphaOne);
+
+	*weighted = _mm_add_epi32(*weighted, _mm_madd_epi16(words, weights));
+	*plain = _mm_add_epi32(*plain, _mm_madd_epi16(words, _mm_set1_epi16(1)));
+}
+
+
+static VOID SumRowSSE2(const BYTE* src, INT32 newWidth, INT32 factor, UINT32* sums) {
+	for (INT32 x = 0; x < newWidth; x++) {
+		__m128i weighted = _mm_loadu_si128((const __m128i*)sums);
+		__m128i plain = _mm_loadu_si128((const __m128i*)(sums + 4));
+		INT32 i = 0;
+
+		for (; i + 2 <= factor; i += 2) {
+			SumPairSSE2(_mm_loadl_epi64((const __m128i*)(src + i * 4)), &weighted, &plain);
+		}
+
+		// An odd pixel is paired with transparent black, which adds nothing
+		if (i < factor) {
+			SumPairSSE2(_mm_cvtsi32_si128(*(const INT32*)(src + i * 4)), &weighted, &plain);
+		}
+
+		_mm_storeu_si128((__m128i*)sums, weighted);
+		_mm_storeu_si128((__m128i*)(sums + 4), plain);
+
+		src += factor * 4;
+		sums += 8;
+	}
+}
+
+
+// Divides one pixel's sums, colors by the alpha sum and alpha by the count.
+// A zero alpha sum takes the unweighted colors over the count instead.
+// Lanes stay 32-bit.
+static __m128i ResolvePixelSSE2(const UINT32* sums, __m128i count) {
+	const __m128i colorMask = _mm_set_epi32(0, -1, -1, -1);
+
+	__m128i weighted = _mm_loadu_si128((const __m128i*)sums);
+	__m128i plain = _mm_loadu_si128((const __m128i*)(sums + 4));
+	__m128i alpha = _mm_shuffle_epi32(weighted, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i transparent = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+
+	__m128i values = _mm_or_si128(_mm_and_si128(transparent, plain), _mm_andnot_si128(transparent, weighted));
+	__m128i divisor = _mm_or_si128(_mm_and_si128(transparent, count), _mm_andnot_si128(transparent, alpha));
+
+	divisor = _mm_or_si128(_mm_and_si128(divisor, colorMask), _mm_andnot_si128(colorMask, count));
+
+	__m128 result = _mm_div_ps(_mm_cvtepi32_ps(values), _mm_cvtepi32_ps(divisor));
+
+	return _mm_cvttps_epi32(_mm_add_ps(result, _mm_set1_ps(0.5f)));
+}
+
+
+static VOID ResolveRowSSE2(const UINT32* sums, INT32 newWidth, UINT32 count, BYTE* dst) {
+	__m128i countAll = _mm_set1_epi32((INT32)count);
+	INT32 x = 0;
+
+	for (; x + 4 <= newWidth; x += 4) {
+		__m128i p0 = ResolvePixelSSE2(sums, countAll);
+		__m128i p1 = ResolvePixelSSE2(sums + 8, countAll);
+		__m128i p2 = ResolvePixelSSE2(sums + 16, countAll);
+		__m128i p3 = ResolvePixelSSE2(sums + 24, countAll);
+
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+
+		_mm_storeu_si128((__m128i*)dst, packed);
+
+		sums += 32;
+		dst += 16;
+	}
+
+	for (; x < newWidth; x++) {
+		__m128i p = ResolvePixelSSE2(sums, countAll);
+
+		*(INT32*)dst = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(p, p), p));
+
+		sums += 8;
+		dst += 4;
+	}
+}
+
+
+//
+// AVX2
+//
+
+// SumPairSSE2 for four pixels, the low lanes hold the sums of the first
+// pair and the high lanes the sums of the second.
+static VOID SumPairsAVX2(__m128i pixels, __m256i* weighted, __m256i* plain) {
+	const __m256i order = _mm256_setr_epi8(
+		0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+		0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+	const __m256i colorMask = _mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0);
+	const __m256i alphaOne = _mm256_setr_epi32(0, 0, 0, 0x00010001, 0, 0, 0, 0x00010001);
+
+	__m256i words = _mm256_shuffle_epi8(_mm256_cvtepu8_epi16(pixels), order);
+	__m256i alpha = _mm256_shuffle_epi32(words, _MM_SHUFFLE(3, 3, 3, 3));
+	__m256i weights = _mm256_or_si256(_mm256_and_si256(alpha, colorMask), alphaOne);
+
+	*weighted = _mm256_add_epi32(*weighted, _mm256_madd_epi16(words, weights));
+	*plain = _mm256_add_epi32(*plain, _mm256_madd_epi16(words, _mm256_set1_epi16(1)));
+}
+
+
+// 2x, two output pixels per load
+static VOID SumRow2AVX2(const BYTE* src, INT32 newWidth, INT32 factor, UINT32* sums) {
+	INT32 x = 0;
+
+	for (; x + 2 <= newWidth; x += 2) {
+		__m256i weighted = _mm256_setzero_si256();
+		__m256i plain = _mm256_setzero_si256();
+
+		SumPairsAVX2(_mm_loadu_si128((const __m128i*)src), &weighted, &plain);
+
+		// Regroup to the weighted and plain sums of each output pixel
+		__m256i first = _mm256_permute2x128_si256(weighted, plain, 0x20);
+		__m256i second = _mm256_permute2x128_si256(weighted, plain, 0x31);
+
+		_mm256_storeu_si256((__m256i*)sums, _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)sums), first));
+		_mm256_storeu_si256((__m256i*)(sums + 8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(sums + 8)), second));
+
+		src += 16;
+		sums += 16;
+	}
+
+	SumRowSSE2(src, newWidth - x, factor, sums);
+}
+
+
+// Multiples of 4, the two lanes are folded once per output pixel
+static VOID SumRow4AVX2(const BYTE* src, INT32 newWidth, INT32 factor, UINT32* sums) {
+	for (INT32 x = 0; x < newWidth; x++) {
+		__m256i weighted = _mm256_setzero_si256();
+		__m256i plain = _mm256_setzero_si256();
+
+		for (INT32 i = 0; i < factor; i += 4) {
+			SumPairsAVX2(_mm_loadu_si128((const __m128i*)(src + i * 4)), &weighted, &plain);
+		}
+
+		// Fold the pair lanes, then the weighted sums go low and the plain ones high
+		__m256i folded = _mm256_add_epi32(
+			_mm256_permute2x128_si256(weighted, plain, 0x20),
+			_mm256_permute2x128_si256(weighted, plain, 0x31));
+
+		_mm256_storeu_si256((__m256i*)sums, _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)sums), folded));
+
+		src += factor * 4;
+		sums += 8;
+	}
+}
+
+#endif
+
+
+static BOX_SUM_ROW GetSumRow(INT32 factor) {
+#ifdef BOX_DOWNSCALE_SIMD
+	DWORD features = GetCpuFeatures();
+
+	if (features & CPU_AVX2) {
+		if (factor == 2) {
+			return SumRow2AVX2;
+		}
+
+		if (factor % 4 == 0) {
+			return SumRow4AVX2;
+		}
+	}
+
+	if (features & CPU_SSE2) {
+		return SumRowSSE2;
+	}
+#endif
+
+	return SumRowScalar;
+}
+
+
+static BOX_RESOLVE_ROW GetResolveRow() {
+#ifdef BOX_DOWNSCALE_SIMD
+	if (GetCpuFeatures() & CPU_SSE2) {
+		return ResolveRowSSE2;
+	}
+#endif
+
+	return ResolveRowScalar;
+}
+
+
+BOOL CanBoxDownscale(INT32 width, INT32 height, INT32 newWidth, INT32 newHeight) {
+	if (newWidth <= 0 || newHeight <= 0 || newWidth > width || newHeight > height) {
+		return FALSE;
+	}
+
+	if (width % newWidth != 0 || height % newHeight != 0) {
+		return FALSE;
+	}
+
+	// Both factors can be large on their own, the product is taken in 64 bits
+	return (UINT64)(width / newWidth) * (UINT64)(height / newHeight) <= BOX_MAX_PIXELS;
+}
+
+
+HRESULT BoxDownscale(const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride) {
+	if (!CanBoxDownscale(width, height, newWidth, newHeight)) {
+		return E_INVALIDARG;
+	}
+
+	INT32 factorX = width / newWidth;
+	INT32 factorY = height / newHeight;
+	// At most BOX_MAX_PIXELS, checked above
+	UINT32 count = (UINT32)factorX * (UINT32)factorY;
+
+	size_t sumsSize = (size_t)newWidth * 8 * sizeof(UINT32);
+
+	UINT32* sums = (UINT32*)malloc(sumsSize);
+
+	if (sums == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	BOX_SUM_ROW sumRow = GetSumRow(factorX);
+	BOX_RESOLVE_ROW resolveRow = GetResolveRow();
+
+	for (INT32 y = 0; y < newHeight; y++) {
+		const BYTE* src = input + (size_t)y * factorY * inputStride;
+
+		memset(sums, 0, sumsSize);
+
+		for (INT32 i = 0; i < factorY; i++) {
+			sumRow(src, newWidth, factorX, sums);
+			src += inputStride;
+		}
+
+		resolveRow(sums, newWidth, count, output + (size_t)y * outputStride);
+	}
+
+	free(sums);
+
+	return S_OK;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// TRUE if both sides shrink by a whole factor (1 included) and each output
+// pixel covers few enough source pixels for the 32-bit sums.
+BOOL CanBoxDownscale(INT32 width, INT32 height, INT32 newWidth, INT32 newHeight);
+
+// Averages each block of source pixels into one output pixel. Pixels are 4
+// bytes with straight alpha last (BGRA or RGBA), colors are weighted by
+// alpha like the stb resizer does. Fails with E_INVALIDARG if the sizes do
+// not pass CanBoxDownscale.
+HRESULT BoxDownscale(const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride);
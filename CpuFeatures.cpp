@@ -0,0 +1,63 @@
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
+
+
+static LONG g_detected = -1;
+
+
+static DWORD DetectCpuFeatures() {
+	DWORD features = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	int info[4];
+
+	__cpuid(info, 0);
+
+	int maxLeaf = info[0];
+
+	if (maxLeaf < 1) {
+		return 0;
+	}
+
+	__cpuid(info, 1);
+
+	if (info[3] & (1 << 26)) {
+		features |= CPU_SSE2;
+	}
+
+	if (info[2] & (1 << 9)) {
+		features |= CPU_SSSE3;
+	}
+
+	if (info[2] & (1 << 19)) {
+		features |= CPU_SSE41;
+	}
+
+	// AVX2 also needs the OS to save the YMM state (OSXSAVE + XCR0)
+	BOOL osxsave = (info[2] & (1 << 27)) != 0;
+	BOOL avx = (info[2] & (1 << 28)) != 0;
+
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+
+		if (info[1] & (1 << 5)) {
+			features |= CPU_AVX2;
+		}
+	}
+#endif
+
+	return features;
+}
+
+
+DWORD GetCpuFeatures() {
+	// Detection is idempotent, racing threads store the same value
+	if (g_detected < 0) {
+		g_detected = (LONG)DetectCpuFeatures();
+	}
+
+	return (DWORD)g_detected;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Windows.h>
+
+
+enum {
+	CPU_SSE2 = 0x1,
+	CPU_SSSE3 = 0x2,
+	CPU_SSE41 = 0x4,
+	CPU_AVX2 = 0x8
+};
+
+
+// Instruction sets usable by the SIMD kernels, detected once.
+DWORD GetCpuFeatures();
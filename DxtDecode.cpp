@@ -0,0 +1,471 @@
+#include "DxtDecode.h"
+#include "Bc7Decode.h"
+#include "BoxDownscale.h"
+#include "CpuFeatures.h"
+
+#include "dxt.hpp"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define DXT_DECODE_SIMD
+#include <immintrin.h>
+#endif
+
+
+INT32 GetDXTBlockSize(DWORD format) {
+	switch (format) {
+		case DXT_FORMAT_DXT1:
+		case DXT_FORMAT_BC4: {
+			return 8;
+		}
+		case DXT_FORMAT_DXT3:
+		case DXT_FORMAT_DXT5:
+		case DXT_FORMAT_BC5:
+		case DXT_FORMAT_BC7: {
+			return 16;
+		}
+	}
+
+	return 0;
+}
+
+
+static DXT_BLOCK_DECODER GetBlockDecoder(DWORD format) {
+	switch (format) {
+		case DXT_FORMAT_DXT1: {
+			return DecodeDXT1Block;
+		}
+		case DXT_FORMAT_DXT3: {
+			return DecodeDXT3Block;
+		}
+		case DXT_FORMAT_BC4: {
+			return DecodeBC4Block;
+		}
+		case DXT_FORMAT_BC5: {
+			return DecodeBC5Block;
+		}
+		case DXT_FORMAT_BC7: {
+			return DecodeBC7Block;
+		}
+	}
+
+	return DecodeDXT5Block;
+}
+
+
+// DXT1, DXT3 and DXT5, the formats the SIMD kernels and the color only
+// decoder handle. The others go through their block decoders.
+static BOOL HasColorBlock(DWORD format) {
+	return format == DXT_FORMAT_DXT1 || format == DXT_FORMAT_DXT3 || format == DXT_FORMAT_DXT5;
+}
+
+
+#ifdef DXT_DECODE_SIMD
+
+//
+// SSE4.1
+//
+
+// Builds the four colors of a block as 16 bytes B, G, R, 0. The endpoint
+// expansion uses the same integer divides as the scalar decoder, the
+// thirds are computed as (x * 0xAAAB) >> 17 which is exact for x <= 765.
+static __m128i DecodeColorTableSSE41(const BYTE* block) {
+	UINT16 color0 = *(const UINT16*)(block + 0);
+	UINT16 color1 = *(const UINT16*)(block + 2);
+
+	__m128i endpoints = _mm_setr_epi16(
+		(color0 & 0x1F) * 255 / 31, ((color0 >> 5) & 0x3F) * 255 / 63, ((color0 >> 11) & 0x1F) * 255 / 31, 0,
+		(color1 & 0x1F) * 255 / 31, ((color1 >> 5) & 0x3F) * 255 / 63, ((color1 >> 11) & 0x1F) * 255 / 31, 0);
+
+	// [2 * c0 + c1, 2 * c1 + c0] / 3
+	__m128i swapped = _mm_shuffle_epi32(endpoints, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(endpoints, endpoints), swapped);
+	__m128i thirds = _mm_srli_epi16(_mm_mulhi_epu16(sum, _mm_set1_epi16((short)0xAAAB)), 1);
+
+	// [(c0 + c1) / 2, black]
+	__m128i half = _mm_srli_epi16(_mm_add_epi16(endpoints, swapped), 1);
+	__m128i halves = _mm_blend_epi16(half, _mm_setzero_si128(), 0xF0);
+
+	__m128i select = _mm_set1_epi16(color0 > color1 ? -1 : 0);
+	__m128i inner = _mm_blendv_epi8(halves, thirds, select);
+
+	return _mm_packus_epi16(endpoints, inner);
+}
+
+
+// DXT1 keeps alpha in the color table: opaque, except code 3 in the
+// three color mode.
+static __m128i DecodeColorTableDXT1SSE41(const BYTE* block) {
+	UINT16 color0 = *(const UINT16*)(block + 0);
+	UINT16 color1 = *(const UINT16*)(block + 2);
+
+	__m128i alpha = color0 > color1
+		? _mm_set1_epi32((INT32)0xFF000000)
+		: _mm_setr_epi32((INT32)0xFF000000, (INT32)0xFF000000, (INT32)0xFF000000, 0);
+
+	return _mm_or_si128(DecodeColorTableSSE41(block), alpha);
+}
+
+
+// Builds the 16 DXT5 alpha values of a block in pixel order. The table steps
+// are (x * 0x2493) >> 16 for sevenths and (x * 0x3334) >> 16 for fifths,
+// both exact for the sums that can occur.
+static __m128i DecodeAlphaSSE41(const BYTE* block) {
+	INT32 alpha0 = block[0];
+	INT32 alpha1 = block[1];
+
+	__m128i a0 = _mm_set1_epi16((short)alpha0);
+	__m128i a1 = _mm_set1_epi16((short)alpha1);
+
+	__m128i table;
+
+	if (alpha0 > alpha1) {
+		__m128i sum = _mm_add_epi16(
+			_mm_mullo_epi16(a0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+			_mm_mullo_epi16(a1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+
+		table = _mm_mulhi_epu16(sum, _mm_set1_epi16(0x2493));
+	}
+	else {
+		__m128i sum = _mm_add_epi16(
+			_mm_mullo_epi16(a0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+			_mm_mullo_epi16(a1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+
+		table = _mm_mulhi_epu16(sum, _mm_set1_epi16(0x3334));
+		table = _mm_blend_epi16(table, _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255), 0xC0);
+	}
+
+	table = _mm_packus_epi16(table, table);
+
+	// Gather the 16-bit window holding each 3-bit index, then shift it to
+	// the top with a multiply and back down by 13
+	const __m128i windowLo = _mm_setr_epi8(2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 4, 5, 4, 5);
+	const __m128i windowHi = _mm_setr_epi8(5, 6, 5, 6, 5, 6, 6, 7, 6, 7, 6, 7, 7, -1, 7, -1);
+	const __m128i scale = _mm_setr_epi16(1 << 13, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+
+	__m128i bits = _mm_loadl_epi64((const __m128i*)block);
+
+	__m128i indicesLo = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bits, windowLo), scale), 13);
+	__m128i indicesHi = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bits, windowHi), scale), 13);
+
+	return _mm_shuffle_epi8(table, _mm_packus_epi16(indicesLo, indicesHi));
+}
+
+
+// Builds the 16 DXT3 alpha values of a block in pixel order, each 4-bit
+// value n becomes n * 17.
+static __m128i DecodeExplicitAlphaSSE41(const BYTE* block) {
+	__m128i bits = _mm_loadl_epi64((const __m128i*)block);
+	__m128i mask = _mm_set1_epi8(0x0F);
+
+	__m128i lo = _mm_and_si128(bits, mask);
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(bits, 4), mask);
+
+	__m128i alphas = _mm_unpacklo_epi8(lo, hi);
+
+	return _mm_or_si128(alphas, _mm_slli_epi16(alphas, 4));
+}
+
+
+// Color table, per pixel alpha (zero for DXT1) and the 2-bit color
+// indices of a block.
+static INT32 DecodeBlockTablesSSE41(const BYTE* block, DWORD format, __m128i* colors, __m128i* alphas) {
+	switch (format) {
+		case DXT_FORMAT_DXT1: {
+			*colors = DecodeColorTableDXT1SSE41(block);
+			*alphas = _mm_setzero_si128();
+			return *(const INT32*)(block + 4);
+		}
+		case DXT_FORMAT_DXT3: {
+			*colors = DecodeColorTableSSE41(block + 8);
+			*alphas = DecodeExplicitAlphaSSE41(block);
+			return *(const INT32*)(block + 12);
+		}
+	}
+
+	*colors = DecodeColorTableSSE41(block + 8);
+	*alphas = DecodeAlphaSSE41(block);
+	return *(const INT32*)(block + 12);
+}
+
+
+// Moves the 4 alpha values of a block row to the alpha byte of each pixel.
+static __m128i RowAlphaShuffleSSE41(INT32 row) {
+	INT32 first = 4 * row;
+
+	return _mm_setr_epi32(
+		0x00808080 | (first << 24), 0x00808080 | ((first + 1) << 24),
+		0x00808080 | ((first + 2) << 24), 0x00808080 | ((first + 3) << 24));
+}
+
+
+// Turns the index byte of one block row, repeated in every byte, into a
+// pshufb mask picking the 4 bytes of each pixel's color.
+static __m128i RowShuffleSSE41(__m128i row) {
+	const __m128i bit0 = _mm_setr_epi8(0x01, 0x01, 0x01, 0x01, 0x04, 0x04, 0x04, 0x04, 0x10, 0x10, 0x10, 0x10, 0x40, 0x40, 0x40, 0x40);
+	const __m128i bit1 = _mm_add_epi8(bit0, bit0);
+	const __m128i base = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+
+	__m128i lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(row, bit0), bit0), _mm_set1_epi8(4));
+	__m128i hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(row, bit1), bit1), _mm_set1_epi8(8));
+
+	return _mm_or_si128(_mm_or_si128(lo, hi), base);
+}
+
+
+static VOID DecodeBlockRowsSSE41(const BYTE* block, DWORD format, __m128i rows[4]) {
+	__m128i colors;
+	__m128i alphas;
+	__m128i bits = _mm_cvtsi32_si128(DecodeBlockTablesSSE41(block, format, &colors, &alphas));
+
+	for (INT32 row = 0; row < 4; row++) {
+		__m128i broadcast = _mm_shuffle_epi8(bits, _mm_set1_epi8((char)row));
+
+		rows[row] = _mm_or_si128(
+			_mm_shuffle_epi8(colors, RowShuffleSSE41(broadcast)),
+			_mm_shuffle_epi8(alphas, RowAlphaShuffleSSE41(row)));
+	}
+}
+
+
+// Stores the first columns x rows pixels of a block, whole rows when the
+// block is not clipped on the right.
+static VOID DecodeBlockSSE41(const BYTE* block, DWORD format, BYTE* output, size_t stride, INT32 columns, INT32 rows) {
+	__m128i pixels[4];
+	DecodeBlockRowsSSE41(block, format, pixels);
+
+	for (INT32 row = 0; row < rows; row++) {
+		if (columns == 4) {
+			_mm_storeu_si128((__m128i*)(output + row * stride), pixels[row]);
+		}
+		else {
+			memcpy(output + row * stride, &pixels[row], (size_t)columns * 4);
+		}
+	}
+}
+
+
+static VOID DecodeDXTSSE41(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride) {
+	INT32 blockSize = GetDXTBlockSize(format);
+	INT32 blocksX = (width + 3) / 4;
+	INT32 blocksY = (height + 3) / 4;
+
+	for (INT32 blockY = 0; blockY < blocksY; blockY++) {
+		const BYTE* block = input + (size_t)blockY * blocksX * blockSize;
+		BYTE* row = output + (size_t)blockY * 4 * stride;
+		INT32 rows = min(4, height - blockY * 4);
+
+		for (INT32 blockX = 0; blockX < blocksX; blockX++) {
+			DecodeBlockSSE41(block + blockX * blockSize, format, row + blockX * 16, stride, min(4, width - blockX * 4), rows);
+		}
+	}
+}
+
+
+//
+// AVX2
+//
+
+// Two neighbouring blocks per iteration, one in each 128-bit lane, so
+// every block row is a single 32 byte store.
+static VOID DecodeBlockPairAVX2(const BYTE* block, DWORD format, INT32 blockSize, BYTE* output, size_t stride) {
+	const __m256i bit0 = _mm256_setr_epi8(
+		0x01, 0x01, 0x01, 0x01, 0x04, 0x04, 0x04, 0x04, 0x10, 0x10, 0x10, 0x10, 0x40, 0x40, 0x40, 0x40,
+		0x01, 0x01, 0x01, 0x01, 0x04, 0x04, 0x04, 0x04, 0x10, 0x10, 0x10, 0x10, 0x40, 0x40, 0x40, 0x40);
+	const __m256i bit1 = _mm256_add_epi8(bit0, bit0);
+	const __m256i base = _mm256_setr_epi8(
+		0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3,
+		0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+
+	__m128i colors0;
+	__m128i alphas0;
+	INT32 bits0 = DecodeBlockTablesSSE41(block, format, &colors0, &alphas0);
+
+	__m128i colors1;
+	__m128i alphas1;
+	INT32 bits1 = DecodeBlockTablesSSE41(block + blockSize, format, &colors1, &alphas1);
+
+	__m256i colors = _mm256_inserti128_si256(_mm256_castsi128_si256(colors0), colors1, 1);
+	__m256i alphas = _mm256_inserti128_si256(_mm256_castsi128_si256(alphas0), alphas1, 1);
+	__m256i bits = _mm256_setr_epi32(bits0, 0, 0, 0, bits1, 0, 0, 0);
+
+	for (INT32 row = 0; row < 4; row++) {
+		__m256i broadcast = _mm256_shuffle_epi8(bits, _mm256_set1_epi8((char)row));
+
+		__m256i lo = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(broadcast, bit0), bit0), _mm256_set1_epi8(4));
+		__m256i hi = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(broadcast, bit1), bit1), _mm256_set1_epi8(8));
+		__m256i shuffle = _mm256_or_si256(_mm256_or_si256(lo, hi), base);
+
+		__m256i pixels = _mm256_or_si256(
+			_mm256_shuffle_epi8(colors, shuffle),
+			_mm256_shuffle_epi8(alphas, _mm256_broadcastsi128_si256(RowAlphaShuffleSSE41(row))));
+
+		_mm256_storeu_si256((__m256i*)(output + row * stride), pixels);
+	}
+}
+
+
+static VOID DecodeDXTAVX2(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride) {
+	INT32 blockSize = GetDXTBlockSize(format);
+	INT32 blocksX = (width + 3) / 4;
+	INT32 blocksY = (height + 3) / 4;
+
+	// Pairs only cover blocks that are not clipped
+	INT32 wholeX = width / 4;
+
+	for (INT32 blockY = 0; blockY < blocksY; blockY++) {
+		const BYTE* block = input + (size_t)blockY * blocksX * blockSize;
+		BYTE* row = output + (size_t)blockY * 4 * stride;
+		INT32 rows = min(4, height - blockY * 4);
+
+		INT32 blockX = 0;
+
+		if (rows == 4) {
+			for (; blockX + 2 <= wholeX; blockX += 2) {
+				DecodeBlockPairAVX2(block + blockX * blockSize, format, blockSize, row + blockX * 16, stride);
+			}
+		}
+
+		for (; blockX < blocksX; blockX++) {
+			DecodeBlockSSE41(block + blockX * blockSize, format, row + blockX * 16, stride, min(4, width - blockX * 4), rows);
+		}
+	}
+}
+
+#endif
+
+
+VOID DecodeDXT(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride) {
+#ifdef DXT_DECODE_SIMD
+	DWORD features = HasColorBlock(format) ? GetCpuFeatures() : 0;
+
+	// The AVX2 kernel finishes odd and clipped blocks with the SSE4.1 one
+	if ((features & CPU_AVX2) && (features & CPU_SSE41)) {
+		DecodeDXTAVX2(input, format, width, height, output, stride);
+		return;
+	}
+
+	if (features & CPU_SSE41) {
+		DecodeDXTSSE41(input, format, width, height, output, stride);
+		return;
+	}
+#endif
+
+	DecompressDXTBGRA((uint8_t*)input, GetDXTBlockSize(format), GetBlockDecoder(format), width, height, (uint32_t*)output, stride);
+}
+
+
+// Averages one cell clipped by the right or bottom edge, only the texels
+// inside the image count. Weighted by alpha and rounded like BoxDownscale.
+static VOID AverageEdgeCell(const BYTE* input, size_t stride, INT32 columns, INT32 rows, BYTE* output) {
+	UINT32 weighted[3] = { 0, 0, 0 };
+	UINT32 plain[3] = { 0, 0, 0 };
+	UINT32 alpha = 0;
+
+	for (INT32 y = 0; y < rows; y++) {
+		const BYTE* pixel = input + y * stride;
+
+		for (INT32 x = 0; x < columns; x++) {
+			for (INT32 i = 0; i < 3; i++) {
+				weighted[i] += pixel[i] * pixel[3];
+				plain[i] += pixel[i];
+			}
+
+			alpha += pixel[3];
+			pixel += 4;
+		}
+	}
+
+	UINT32 count = (UINT32)(columns * rows);
+	const UINT32* colors = alpha != 0 ? weighted : plain;
+	UINT32 divisor = alpha != 0 ? alpha : count;
+
+	for (INT32 i = 0; i < 3; i++) {
+		output[i] = (BYTE)(INT32)((float)(INT32)colors[i] / (float)(INT32)divisor + 0.5f);
+	}
+
+	output[3] = (BYTE)(INT32)((float)(INT32)alpha / (float)(INT32)count + 0.5f);
+}
+
+
+// Decodes one block row at a time into a 4 row strip, whole cells of it are
+// box averaged and the clipped ones at the edges averaged on their own.
+HRESULT DecodeDXTReduced(const BYTE* input, DWORD format, INT32 width, INT32 height, INT32 scale, BYTE* output, size_t stride, BYTE* strip) {
+	HRESULT hr;
+
+	INT32 blockSize = GetDXTBlockSize(format);
+	INT32 blocksX = (width + 3) / 4;
+	INT32 blocksY = (height + 3) / 4;
+	INT32 cells = 4 / scale;
+	INT32 wholeWidth = width / scale;
+	INT32 outputWidth = (width + scale - 1) / scale;
+	size_t stripStride = (size_t)width * 4;
+
+	for (INT32 blockY = 0; blockY < blocksY; blockY++) {
+		INT32 rows = min(4, height - blockY * 4);
+		INT32 wholeRows = rows / scale;
+		BYTE* row = output + (size_t)blockY * cells * stride;
+
+		DecodeDXT(input + (size_t)blockY * blocksX * blockSize, format, width, rows, strip, stripStride);
+
+		if (wholeWidth > 0 && wholeRows > 0) {
+			hr = BoxDownscale(strip, wholeWidth * scale, wholeRows * scale, (INT32)stripStride, row, wholeWidth, wholeRows, (INT32)stride);
+			if (FAILED(hr)) {
+				return hr;
+			}
+		}
+
+		for (INT32 cellY = 0; cellY * scale < rows; cellY++) {
+			INT32 cellRows = min(scale, rows - cellY * scale);
+
+			for (INT32 cellX = cellRows == scale ? wholeWidth : 0; cellX < outputWidth; cellX++) {
+				AverageEdgeCell(strip + cellY * scale * stripStride + (size_t)cellX * scale * 4, stripStride,
+					min(scale, width - cellX * scale), cellRows, row + cellY * stride + (size_t)cellX * 4);
+			}
+		}
+	}
+
+	return S_OK;
+}
+
+
+size_t GetDXTStripSize(INT32 width) {
+	return (size_t)width * 4 * 4;
+}
+
+
+VOID DecodeDXTRGB(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride) {
+	if (HasColorBlock(format)) {
+		DecompressDXTColors((uint8_t*)input, GetDXTBlockSize(format), width, height, (RGB24*)output, stride);
+		return;
+	}
+
+	DXT_BLOCK_DECODER decodeBlock = GetBlockDecoder(format);
+	INT32 blockSize = GetDXTBlockSize(format);
+
+	INT32 blocksX = (width + 3) / 4;
+	INT32 blocksY = (height + 3) / 4;
+
+	for (INT32 blockY = 0; blockY < blocksY; blockY++) {
+		for (INT32 blockX = 0; blockX < blocksX; blockX++) {
+			UINT32 pixels[16];
+			decodeBlock(input + ((size_t)blockY * blocksX + blockX) * blockSize, pixels);
+
+			INT32 columns = min(4, width - blockX * 4);
+			INT32 rows = min(4, height - blockY * 4);
+
+			for (INT32 y = 0; y < rows; y++) {
+				BYTE* pixel = output + ((size_t)blockY * 4 + y) * stride + (size_t)blockX * 12;
+
+				for (INT32 x = 0; x < columns; x++) {
+					UINT32 color = pixels[y * 4 + x];
+
+					pixel[0] = (BYTE)(color >> 16);
+					pixel[1] = (BYTE)(color >> 8);
+					pixel[2] = (BYTE)(color);
+
+					pixel += 3;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// DDS FourCC codes of the block formats with a decoder. BC7 has no FourCC
+// of its own, DX10 headers are mapped to these codes by the parser.
+enum {
+	DXT_FORMAT_DXT1 = 0x31545844,
+	DXT_FORMAT_DXT3 = 0x33545844,
+	DXT_FORMAT_DXT5 = 0x35545844,
+	DXT_FORMAT_BC4 = 0x55344342,
+	DXT_FORMAT_BC5 = 0x55354342,
+	DXT_FORMAT_BC7 = 0x55374342
+};
+
+
+// Bytes per 4x4 block, 0 if the format has no decoder.
+INT32 GetDXTBlockSize(DWORD format);
+
+// Decodes DXT1 (BC1), DXT3 (BC2), DXT5 (BC3), BC4, BC5 or BC7 blocks to
+// 32-bit B, G, R, A pixels with straight alpha. Exactly width x height
+// pixels are written, output rows are stride bytes apart. Matches the
+// dxt.hpp decoders bit for bit.
+VOID DecodeDXT(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride);
+
+// Same as DecodeDXT at 1/2 or 1/4 resolution, every pixel is the alpha
+// weighted average of a 2x2 or 4x4 texel cell, like BoxDownscale. Cells cut
+// by the right or bottom edge average the texels inside the image only.
+// Writes (width + scale - 1) / scale by (height + scale - 1) / scale pixels.
+// strip is scratch space for one decoded row of blocks, GetDXTStripSize bytes.
+HRESULT DecodeDXTReduced(const BYTE* input, DWORD format, INT32 width, INT32 height, INT32 scale, BYTE* output, size_t stride, BYTE* strip);
+
+size_t GetDXTStripSize(INT32 width);
+
+// Same as DecodeDXT with 24-bit R, G, B output, alpha is dropped.
+VOID DecodeDXTRGB(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride);
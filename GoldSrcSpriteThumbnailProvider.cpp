@@ -12,13 +12,34 @@
 #include <msxml6.h>
 #include <new>
 #include "SpriteLoader.h"
-#include "stb_image_resize2.h"
+#include "BoxDownscale.h"
+#include "NearestUpscale.h"
+#include "ResizeCache.h"
+#include "PaletteExpand.h"
 
 #pragma comment(lib, "shlwapi.lib")
 #pragma comment(lib, "windowscodecs.lib")
 #pragma comment(lib, "Crypt32.lib")
 #pragma comment(lib, "msxml6.lib")
 
+// Per-user settings, all values optional
+#define SZ_SETTINGS_KEY     L"Software\\GoldSrcSpriteThumbnailProvider"
+
+// DWORD "UpscaleFilter", how thumbnails larger than the sprite are filled
+enum
+{
+	UPSCALE_FILTER_NEAREST = 0, // crisp pixels, the default
+	UPSCALE_FILTER_SMOOTH = 1   // stb filter
+};
+
+static LONG g_upscaleFilter = -1;
+
+// DWORD "DecodeMemoryLimit", MiB a frame may take before it is streamed in bands
+#define DEFAULT_DECODE_MEMORY_LIMIT 16
+#define MAX_DECODE_MEMORY_LIMIT     1024
+
+static LONG g_decodeMemoryLimit = -1;
+
 // this thumbnail provider implements IInitializeWithStream to enable being hosted
 // in an isolated process for robustness
 
@@ -103,28 +124,192 @@ IFACEMETHODIMP CSpriteThumbProvider::Initialize(IStream* pStream, DWORD)
 	return hr;
 }
 
-static HRESULT ScaleImage(int nNewWidth, int nNewHeight, int nWidth, int nHeight, const BYTE* pPixels, BYTE** ppResult)
+static DWORD ReadSetting(PCWSTR pszName, DWORD dwDefault)
 {
-	size_t nSize = (size_t)nNewWidth * (size_t)nNewHeight * 3;
+	DWORD dwValue = dwDefault;
+	DWORD cbValue = sizeof(dwValue);
+
+	if (RegGetValueW(HKEY_CURRENT_USER, SZ_SETTINGS_KEY, pszName, RRF_RT_REG_DWORD, NULL, &dwValue, &cbValue) != ERROR_SUCCESS)
+	{
+		dwValue = dwDefault;
+	}
 
-	BYTE* pBuffer = (BYTE*)malloc(nSize);
+	return dwValue;
+}
 
-	if (pBuffer == NULL)
+static DWORD GetUpscaleFilter()
+{
+	// Read once per process, racing threads store the same value
+	if (g_upscaleFilter < 0)
 	{
-		return E_OUTOFMEMORY;
+		DWORD dwValue = ReadSetting(L"UpscaleFilter", UPSCALE_FILTER_NEAREST);
+
+		g_upscaleFilter = (dwValue == UPSCALE_FILTER_SMOOTH) ? UPSCALE_FILTER_SMOOTH : UPSCALE_FILTER_NEAREST;
 	}
+	return (DWORD)g_upscaleFilter;
+}
 
-	memset(pBuffer, 0, nSize);
+static size_t GetDecodeMemoryLimit()
+{
+	if (g_decodeMemoryLimit < 0)
+	{
+		DWORD dwValue = ReadSetting(L"DecodeMemoryLimit", DEFAULT_DECODE_MEMORY_LIMIT);
 
-	stbir_resize(pPixels, nWidth, nHeight, nWidth * 3, pBuffer, nNewWidth, nNewHeight, nNewWidth * 3,
-		STBIR_RGB, STBIR_TYPE_UINT8, STBIR_EDGE_ZERO, STBIR_FILTER_DEFAULT);
+		if (dwValue == 0 || dwValue > MAX_DECODE_MEMORY_LIMIT)
+		{
+			dwValue = DEFAULT_DECODE_MEMORY_LIMIT;
+		}
 
-	*ppResult = pBuffer;
+		g_decodeMemoryLimit = (LONG)dwValue;
+	}
+	return (size_t)g_decodeMemoryLimit * 1024 * 1024;
+}
 
-	return S_OK;
+// Resizes into a top-down 32-bit buffer with rows of nNewWidth pixels
+static HRESULT ScaleImage(int nNewWidth, int nNewHeight, int nWidth, int nHeight, const BYTE* pPixels, BYTE* pOutput)
+{
+	// Small pixel art is shown with hard pixel edges, which is also much cheaper than filtering
+	if (nNewWidth >= nWidth && nNewHeight >= nHeight && GetUpscaleFilter() == UPSCALE_FILTER_NEAREST)
+	{
+		NearestUpscale(pPixels, nWidth, nHeight, nWidth * 4, pOutput, nNewWidth, nNewHeight, nNewWidth * 4);
+		return S_OK;
+	}
+
+	// Whole factors average source blocks directly, no filter taps to apply
+	if (CanBoxDownscale(nWidth, nHeight, nNewWidth, nNewHeight))
+	{
+		return BoxDownscale(pPixels, nWidth, nHeight, nWidth * 4, pOutput, nNewWidth, nNewHeight, nNewWidth * 4);
+	}
+
+	// Straight alpha, colors are weighted by alpha while filtering
+	return CachedResize(pPixels, nWidth, nHeight, nWidth * 4, pOutput, nNewWidth, nNewHeight, nNewWidth * 4, STBIR_BGRA);
+}
+
+// Where the resizer pulls image rows from, the first error reading them is kept
+struct IMAGE_ROWS
+{
+	PSPRITE_IMAGE pImage;
+	HRESULT hr;
+};
+
+// Hands out one span of a row, indices are expanded into the resizer's scratch row
+static void const* ReadImageRows(void* pOutput, void const*, int nPixels, int x, int y, void* pContext)
+{
+	IMAGE_ROWS* pRows = (IMAGE_ROWS*)pContext;
+	PSPRITE_IMAGE pImage = pRows->pImage;
+
+	const BYTE* pRow;
+
+	HRESULT hr = ReadSpriteImageRows(pImage, y, 1, &pRow);
+
+	if (FAILED(hr))
+	{
+		// The resizer cannot be stopped, it gets black rows and the error is returned after
+		if (SUCCEEDED(pRows->hr))
+		{
+			pRows->hr = hr;
+		}
+
+		memset(pOutput, 0, (size_t)nPixels * 4);
+		return pOutput;
+	}
+
+	if (!pImage->Paletted)
+	{
+		return pRow + (size_t)x * 4;
+	}
+
+	ExpandIndices32(pImage->Palette, pRow + x, (BYTE*)pOutput, nPixels);
+	return pOutput;
 }
 
-static HRESULT CreateDIB(BYTE* pPixels, int nWidth, int nHeight, HBITMAP* ppResult)
+// Rows per output row of the box filter, 0 if it does not apply. Indices are
+// only averaged with the same factor on both sides.
+static int GetBoxFactor(int nNewWidth, int nNewHeight, PSPRITE_IMAGE pImage)
+{
+	int nWidth = pImage->Width;
+	int nHeight = pImage->Height;
+
+	if (!CanBoxDownscale(nWidth, nHeight, nNewWidth, nNewHeight))
+	{
+		return 0;
+	}
+
+	if (pImage->Paletted && nWidth / nNewWidth != nHeight / nNewHeight)
+	{
+		return 0;
+	}
+
+	return nHeight / nNewHeight;
+}
+
+// Same as ScaleImage for paletted and streamed images, rows are only read as
+// the filter reaches them so no full size BGRA copy of the frame is made
+static HRESULT ScaleImageRows(int nNewWidth, int nNewHeight, PSPRITE_IMAGE pImage, BYTE* pOutput)
+{
+	HRESULT hr;
+
+	int nWidth = pImage->Width;
+	int nHeight = pImage->Height;
+
+	// Streamed frames always shrink, only whole ones can be enlarged
+	if (pImage->Indices != NULL && nNewWidth >= nWidth && nNewHeight >= nHeight && GetUpscaleFilter() == UPSCALE_FILTER_NEAREST)
+	{
+		NearestUpscaleIndices(pImage->Palette, pImage->Indices, nWidth, nHeight, nWidth, pOutput, nNewWidth, nNewHeight, nNewWidth * 4);
+		return S_OK;
+	}
+
+	// Blocks are averaged as many output rows at a time as a band holds
+	int nFactor = GetBoxFactor(nNewWidth, nNewHeight, pImage);
+	int nBandRows = GetSpriteImageBandRows(pImage);
+
+	if (nFactor > 0 && nFactor <= nBandRows)
+	{
+		int nStep = nBandRows / nFactor;
+
+		for (int y = 0; y < nNewHeight; y += nStep)
+		{
+			int nCount = min(nStep, nNewHeight - y);
+			BYTE* pDst = pOutput + (size_t)y * nNewWidth * 4;
+
+			const BYTE* pRows;
+
+			hr = ReadSpriteImageRows(pImage, y * nFactor, nCount * nFactor, &pRows);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+
+			if (pImage->Paletted)
+			{
+				DownscaleIndices32(pImage->Palette, pRows, nWidth, nCount * nFactor, nFactor, pDst, (size_t)nNewWidth * 4);
+			}
+			else
+			{
+				hr = BoxDownscale(pRows, nWidth, nCount * nFactor, nWidth * 4, pDst, nNewWidth, nCount, nNewWidth * 4);
+				if (FAILED(hr))
+				{
+					return hr;
+				}
+			}
+		}
+
+		return S_OK;
+	}
+
+	// Palette entries are opaque, so the straight layout filters them the same as premultiplied
+	// pixels would while zero edges still match ScaleImage
+	IMAGE_ROWS rows;
+	rows.pImage = pImage;
+	rows.hr = S_OK;
+
+	hr = CachedResizeRows(ReadImageRows, &rows, nWidth, nHeight, pOutput, nNewWidth, nNewHeight, nNewWidth * 4, STBIR_BGRA);
+
+	return FAILED(rows.hr) ? rows.hr : hr;
+}
+
+// Creates a top-down 32-bit DIB and hands out its bits, 32-bit rows need no padding
+static HRESULT CreateDIB(int nWidth, int nHeight, HBITMAP* ppResult, BYTE** ppBits)
 {
 	BITMAPINFO bmi;
 	memset(&bmi, 0, sizeof(BITMAPINFO));
@@ -145,25 +330,8 @@ static HRESULT CreateDIB(BYTE* pPixels, int nWidth, int nHeight, HBITMAP* ppResu
 		return E_OUTOFMEMORY;
 	}
 
-	size_t nSize = (size_t)nWidth * (size_t)nHeight * 4;
-
-	memset(pBits, 0, nSize);
-
-	for (int Y = 0; Y < nHeight; Y++)
-	{
-		for (int X = 0; X < nWidth; X++)
-		{
-			BYTE* pSrc = &pPixels[(Y * nWidth + X) * 3];
-			BYTE* pDst = &pBits[(Y * nWidth + X) * 4];
-
-			pDst[0] = pSrc[2]; // B
-			pDst[1] = pSrc[1]; // G
-			pDst[2] = pSrc[0]; // R
-			pDst[3] = 0xFF;
-		}
-	}
-
 	*ppResult = hBmp;
+	*ppBits = pBits;
 
 	return S_OK;
 }
@@ -187,40 +355,49 @@ IFACEMETHODIMP CSpriteThumbProvider::GetThumbnail(UINT cx, HBITMAP* phbmp, WTS_A
 
 	// Load SPR file
 
-	INT32 nImageWidth;
-	INT32 nImageHeight;
-	PVOID pOriginalImagePixels;
+	SPRITE_IMAGE image;
 
-	hr = LoadSpriteToRGB(_pStream, &nImageWidth, &nImageHeight, &pOriginalImagePixels);
+	hr = LoadSpriteImage(_pStream, (INT32)cx, GetDecodeMemoryLimit(), &image);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	// Scale image
+	// Create Bitmap Object
 
-	BYTE* pScaledImagePixels;
+	// The same size the loader picked the mip level and reduction for
+	int nNewWidth;
+	int nNewHeight;
 
-	int nNewWidth = cx;
-	int nNewHeight = (int)((float)cx / ((float)nImageWidth / (float)nImageHeight));
+	GetThumbnailSize(image.Width, image.Height, (INT32)cx, &nNewWidth, &nNewHeight);
 
-	hr = ScaleImage(nNewWidth, nNewHeight, nImageWidth, nImageHeight, (PBYTE)pOriginalImagePixels, &pScaledImagePixels);
+	HBITMAP hBmp;
+	BYTE* pBits;
 
-	free(pOriginalImagePixels);
+	hr = CreateDIB(nNewWidth, nNewHeight, &hBmp, &pBits);
 
 	if (FAILED(hr)) {
+		FreeSpriteImage(&image);
 		return hr;
 	}
 
-	// Create Bitmap Object
+	// Scale image straight into the bitmap, already in BGRA order with its own alpha
 
-	hr = CreateDIB(pScaledImagePixels, nNewWidth, nNewHeight, phbmp);
+	if (image.Pixels != NULL) {
+		hr = ScaleImage(nNewWidth, nNewHeight, image.Width, image.Height, (PBYTE)image.Pixels, pBits);
+	}
+	else {
+		hr = ScaleImageRows(nNewWidth, nNewHeight, &image, pBits);
+	}
 
-	free(pScaledImagePixels);
+	FreeSpriteImage(&image);
 
 	if (FAILED(hr)) {
+		DeleteObject(hBmp);
 		return hr;
 	}
 
+	*phbmp = hBmp;
+
 	// Finish
 
 	*pdwAlpha = WTSAT_ARGB;
@@ -0,0 +1,181 @@
+#include "NearestUpscale.h"
+#include "CpuFeatures.h"
+#include "PaletteExpand.h"
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define NEAREST_UPSCALE_SIMD
+#include <immintrin.h>
+#endif
+
+
+// Indices expanded at once by the whole factor path, on the stack
+#define NEAREST_INDEX_CHUNK 256
+
+
+// Source index sampled by output index i when size grows to newSize
+static INT32 MapNearest(INT32 i, INT32 size, INT32 newSize) {
+	return (INT32)(((INT64)i * 2 + 1) * size / ((INT64)newSize * 2));
+}
+
+
+//
+// Scalar
+//
+
+// Steps MapNearest along the row, the remainder grows by less than the
+// divisor per pixel as the row does not shrink
+static VOID ReplicateRowScalar(const UINT32* src, INT32 width, UINT32* dst, INT32 newWidth) {
+	INT32 divisor = newWidth * 2;
+	INT32 remainder = width;
+	INT32 index = 0;
+
+	for (INT32 x = 0; x < newWidth; x++) {
+		if (remainder >= divisor) {
+			remainder -= divisor;
+			index++;
+		}
+
+		dst[x] = src[index];
+		remainder += width * 2;
+	}
+}
+
+
+static VOID ReplicateIndexRowScalar(const UINT32* lut, const BYTE* src, INT32 width, UINT32* dst, INT32 newWidth) {
+	INT32 divisor = newWidth * 2;
+	INT32 remainder = width;
+	INT32 index = 0;
+
+	for (INT32 x = 0; x < newWidth; x++) {
+		if (remainder >= divisor) {
+			remainder -= divisor;
+			index++;
+		}
+
+		dst[x] = lut[src[index]];
+		remainder += width * 2;
+	}
+}
+
+
+#ifdef NEAREST_UPSCALE_SIMD
+
+//
+// SSE2
+//
+
+// Whole factors only, every source pixel becomes factor output pixels
+static VOID ReplicateRowSSE2(const UINT32* src, INT32 width, INT32 factor, UINT32* dst) {
+	INT32 x = 0;
+
+	if (factor == 2) {
+		for (; x + 4 <= width; x += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x));
+
+			_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi32(pixels, pixels));
+			_mm_storeu_si128((__m128i*)(dst + 4), _mm_unpackhi_epi32(pixels, pixels));
+
+			dst += 8;
+		}
+	}
+	else if (factor == 4) {
+		for (; x + 4 <= width; x += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x));
+
+			_mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 0, 0, 0)));
+			_mm_storeu_si128((__m128i*)(dst + 4), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 1, 1, 1)));
+			_mm_storeu_si128((__m128i*)(dst + 8), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 2, 2)));
+			_mm_storeu_si128((__m128i*)(dst + 12), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 3)));
+
+			dst += 16;
+		}
+	}
+
+	for (; x < width; x++) {
+		__m128i pixel = _mm_set1_epi32((INT32)src[x]);
+		INT32 i = 0;
+
+		for (; i + 4 <= factor; i += 4) {
+			_mm_storeu_si128((__m128i*)(dst + i), pixel);
+		}
+
+		for (; i < factor; i++) {
+			dst[i] = src[x];
+		}
+
+		dst += factor;
+	}
+}
+
+#endif
+
+
+static VOID ReplicateRow(const UINT32* src, INT32 width, UINT32* dst, INT32 newWidth) {
+#ifdef NEAREST_UPSCALE_SIMD
+	if ((GetCpuFeatures() & CPU_SSE2) && newWidth % width == 0) {
+		ReplicateRowSSE2(src, width, newWidth / width, dst);
+		return;
+	}
+#endif
+
+	ReplicateRowScalar(src, width, dst, newWidth);
+}
+
+
+static VOID ReplicateIndexRow(const UINT32* lut, const BYTE* src, INT32 width, UINT32* dst, INT32 newWidth) {
+	if (newWidth % width != 0) {
+		ReplicateIndexRowScalar(lut, src, width, dst, newWidth);
+		return;
+	}
+
+	INT32 factor = newWidth / width;
+	UINT32 chunk[NEAREST_INDEX_CHUNK];
+
+	for (INT32 x = 0; x < width; x += NEAREST_INDEX_CHUNK) {
+		INT32 count = width - x < NEAREST_INDEX_CHUNK ? width - x : NEAREST_INDEX_CHUNK;
+
+		ExpandIndices32(lut, src + x, (BYTE*)chunk, count);
+		ReplicateRow(chunk, count, dst + (size_t)x * factor, count * factor);
+	}
+}
+
+
+// Builds each output row from the source row it samples, lut selects
+// indices over 32-bit pixels
+static VOID UpscaleRows(const UINT32* lut, const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride) {
+	const BYTE* previousSrc = NULL;
+	const BYTE* previousDst = NULL;
+
+	for (INT32 y = 0; y < newHeight; y++) {
+		const BYTE* src = input + (size_t)MapNearest(y, height, newHeight) * inputStride;
+		BYTE* dst = output + (size_t)y * outputStride;
+
+		// Rows sampling the same source row are plain copies of the first one
+		if (src == previousSrc) {
+			memcpy(dst, previousDst, (size_t)newWidth * 4);
+		}
+		else if (lut != NULL) {
+			ReplicateIndexRow(lut, src, width, (UINT32*)dst, newWidth);
+		}
+		else {
+			ReplicateRow((const UINT32*)src, width, (UINT32*)dst, newWidth);
+		}
+
+		previousSrc = src;
+		previousDst = dst;
+	}
+}
+
+
+VOID NearestUpscale(const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride) {
+	UpscaleRows(NULL, input, width, height, inputStride, output, newWidth, newHeight, outputStride);
+}
+
+
+VOID NearestUpscaleIndices(const UINT32* lut, const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride) {
+	UpscaleRows(lut, input, width, height, inputStride, output, newWidth, newHeight, outputStride);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// Scales 32-bit pixels up by repeating the source pixel nearest to each
+// output pixel's center. Whole factors repeat every pixel equally, other
+// ratios alternate between two run lengths. Neither side may shrink.
+VOID NearestUpscale(const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride);
+
+// Same for 8-bit palette indices, each pixel is looked up in the 32-bit LUT
+// as it is written. Whole factors expand the row in chunks and replicate
+// those, the full source is never expanded.
+VOID NearestUpscaleIndices(const UINT32* lut, const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride);
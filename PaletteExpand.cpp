@@ -0,0 +1,271 @@
+#include "PaletteExpand.h"
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define PALETTE_EXPAND_SIMD
+#include <immintrin.h>
+#endif
+
+
+VOID BuildPaletteLUT(SPRITE_PALETTE* palette, INT32 layout, UINT32* lut) {
+	for (INT32 i = 0; i < 256; i++) {
+		BYTE r = 0;
+		BYTE g = 0;
+		BYTE b = 0;
+
+		if (i < palette->Count) {
+			r = palette->Colors[i].R;
+			g = palette->Colors[i].G;
+			b = palette->Colors[i].B;
+		}
+
+		if (layout == PALETTE_LUT_BGRA) {
+			lut[i] = (UINT32)b | ((UINT32)g << 8) | ((UINT32)r << 16) | 0xFF000000;
+		}
+		else {
+			lut[i] = (UINT32)r | ((UINT32)g << 8) | ((UINT32)b << 16) | 0xFF000000;
+		}
+	}
+}
+
+
+//
+// Scalar
+//
+
+static VOID ExpandIndices32Scalar(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+	UINT32* pDst = (UINT32*)dst;
+
+	for (size_t i = 0; i < count; i++) {
+		pDst[i] = lut[src[i]];
+	}
+}
+
+
+static VOID ExpandIndices24Scalar(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		UINT32 color = lut[src[i]];
+
+		dst[0] = (BYTE)(color);
+		dst[1] = (BYTE)(color >> 8);
+		dst[2] = (BYTE)(color >> 16);
+
+		dst += 3;
+	}
+}
+
+
+#ifdef PALETTE_EXPAND_SIMD
+
+//
+// SSSE3
+//
+
+// There is no gather before AVX2, the four lookups stay scalar and only the
+// packing of the 24-bit output is vectorized. 32-bit output has nothing to
+// pack and uses the scalar loop below AVX2.
+static __m128i LoadEntries4(const UINT32* lut, const BYTE* src) {
+	return _mm_set_epi32((int)lut[src[3]], (int)lut[src[2]], (int)lut[src[1]], (int)lut[src[0]]);
+}
+
+
+static VOID ExpandIndices24SSSE3(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	size_t i = 0;
+
+	// Each store writes 16 bytes of which 12 are kept, stop while the
+	// 4 byte overhang still lands inside the output.
+	for (; count - i >= 6; i += 4) {
+		__m128i colors = _mm_shuffle_epi8(LoadEntries4(lut, src + i), pack);
+		_mm_storeu_si128((__m128i*)(dst + i * 3), colors);
+	}
+
+	ExpandIndices24Scalar(lut, src + i, dst + i * 3, count - i);
+}
+
+
+//
+// AVX2
+//
+
+static __m256i GatherEntries8(const UINT32* lut, const BYTE* src) {
+	__m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+	return _mm256_i32gather_epi32((const int*)lut, indices, 4);
+}
+
+
+static VOID ExpandIndices32AVX2(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), GatherEntries8(lut, src + i));
+	}
+
+	ExpandIndices32Scalar(lut, src + i, dst + i * 4, count - i);
+}
+
+
+static VOID ExpandIndices24AVX2(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+	const __m256i pack = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	size_t i = 0;
+
+	// The upper half is stored at +12 and overhangs by 4 bytes
+	for (; count - i >= 10; i += 8) {
+		__m256i colors = _mm256_shuffle_epi8(GatherEntries8(lut, src + i), pack);
+
+		_mm_storeu_si128((__m128i*)(dst + i * 3), _mm256_castsi256_si128(colors));
+		_mm_storeu_si128((__m128i*)(dst + i * 3 + 12), _mm256_extracti128_si256(colors, 1));
+	}
+
+	ExpandIndices24Scalar(lut, src + i, dst + i * 3, count - i);
+}
+
+#endif
+
+
+VOID ExpandIndices32(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+#ifdef PALETTE_EXPAND_SIMD
+	if (GetCpuFeatures() & CPU_AVX2) {
+		ExpandIndices32AVX2(lut, src, dst, count);
+		return;
+	}
+#endif
+
+	ExpandIndices32Scalar(lut, src, dst, count);
+}
+
+
+VOID ExpandIndices24(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count) {
+#ifdef PALETTE_EXPAND_SIMD
+	DWORD features = GetCpuFeatures();
+
+	if (features & CPU_AVX2) {
+		ExpandIndices24AVX2(lut, src, dst, count);
+		return;
+	}
+
+	if (features & CPU_SSSE3) {
+		ExpandIndices24SSSE3(lut, src, dst, count);
+		return;
+	}
+#endif
+
+	ExpandIndices24Scalar(lut, src, dst, count);
+}
+
+
+//
+// Downscaling
+//
+
+// Blocks up to this many pixels divide through a table of every possible sum
+#define PALETTE_AVERAGE_TABLE_PIXELS 64
+
+
+// Same rounding as BoxDownscale gives opaque pixels, where every color is
+// weighted by an alpha of 255
+static UINT32 AverageChannel(UINT32 sum, UINT32 count) {
+	return (UINT32)(INT32)((float)(INT32)(sum * 255) / (float)(INT32)(count * 255) + 0.5f);
+}
+
+
+VOID DownscaleIndices32(const UINT32* lut, const BYTE* src, INT32 width, INT32 height, INT32 factor, BYTE* dst, size_t dstStride) {
+	// The first three channels of each entry in 16-bit lanes, so one add sums
+	// all of them. A lane holds 257 entries before the sums are moved out.
+	UINT64 lanes[256];
+
+	for (INT32 i = 0; i < 256; i++) {
+		UINT32 color = lut[i];
+
+		lanes[i] = (UINT64)(color & 0xFF) | ((UINT64)((color >> 8) & 0xFF) << 16) | ((UINT64)((color >> 16) & 0xFF) << 32);
+	}
+
+	INT32 newWidth = width / factor;
+	INT32 newHeight = height / factor;
+	UINT32 count = (UINT32)(factor * factor);
+	INT32 flushRows = 257 / factor;
+
+	// Small blocks are common and have few pixels per division
+	BYTE averages[255 * PALETTE_AVERAGE_TABLE_PIXELS + 1];
+	BOOL useTable = count <= PALETTE_AVERAGE_TABLE_PIXELS;
+
+	if (useTable) {
+		for (UINT32 sum = 0; sum <= 255 * count; sum++) {
+			averages[sum] = (BYTE)AverageChannel(sum, count);
+		}
+	}
+
+	for (INT32 y = 0; y < newHeight; y++) {
+		const BYTE* block = src + (size_t)y * factor * width;
+		UINT32* pDst = (UINT32*)(dst + (size_t)y * dstStride);
+
+		for (INT32 x = 0; x < newWidth; x++) {
+			UINT32 sum0 = 0;
+			UINT32 sum1 = 0;
+			UINT32 sum2 = 0;
+
+			if (factor == 2) {
+				UINT64 lanesSum = lanes[block[0]] + lanes[block[1]] + lanes[block[width]] + lanes[block[width + 1]];
+
+				sum0 = (UINT32)(lanesSum & 0xFFFF);
+				sum1 = (UINT32)((lanesSum >> 16) & 0xFFFF);
+				sum2 = (UINT32)((lanesSum >> 32) & 0xFFFF);
+			}
+			else if (factor == 4) {
+				UINT64 lanesSum = 0;
+				const BYTE* row = block;
+
+				for (INT32 j = 0; j < 4; j++) {
+					lanesSum += (lanes[row[0]] + lanes[row[1]]) + (lanes[row[2]] + lanes[row[3]]);
+					row += width;
+				}
+
+				sum0 = (UINT32)(lanesSum & 0xFFFF);
+				sum1 = (UINT32)((lanesSum >> 16) & 0xFFFF);
+				sum2 = (UINT32)((lanesSum >> 32) & 0xFFFF);
+			}
+			else {
+				UINT64 lanesSum = 0;
+				INT32 pendingRows = 0;
+
+				const BYTE* row = block;
+
+				for (INT32 j = 0; j < factor; j++) {
+					INT32 i = 0;
+
+					for (; i + 2 <= factor; i += 2) {
+						lanesSum += lanes[row[i]] + lanes[row[i + 1]];
+					}
+
+					if (i < factor) {
+						lanesSum += lanes[row[i]];
+					}
+
+					if (++pendingRows == flushRows || j == factor - 1) {
+						sum0 += (UINT32)(lanesSum & 0xFFFF);
+						sum1 += (UINT32)((lanesSum >> 16) & 0xFFFF);
+						sum2 += (UINT32)((lanesSum >> 32) & 0xFFFF);
+
+						lanesSum = 0;
+						pendingRows = 0;
+					}
+
+					row += width;
+				}
+			}
+
+			if (useTable) {
+				*pDst++ = (UINT32)averages[sum0] | ((UINT32)averages[sum1] << 8) | ((UINT32)averages[sum2] << 16) | 0xFF000000;
+			}
+			else {
+				*pDst++ = AverageChannel(sum0, count) | (AverageChannel(sum1, count) << 8) | (AverageChannel(sum2, count) << 16) | 0xFF000000;
+			}
+
+			block += factor;
+		}
+	}
+}
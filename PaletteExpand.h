@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "SpriteFile.h"
+
+
+enum {
+	PALETTE_LUT_RGBX = 0,
+	PALETTE_LUT_BGRA
+};
+
+
+// Expands the palette into 256 32-bit entries in the given byte order
+// (alpha/pad byte 0xFF). Indices past the palette map to opaque black.
+VOID BuildPaletteLUT(SPRITE_PALETTE* palette, INT32 layout, UINT32* lut);
+
+// Writes one 32-bit LUT entry per index.
+VOID ExpandIndices32(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count);
+
+// Writes the first three bytes of the LUT entry per index.
+VOID ExpandIndices24(const UINT32* lut, const BYTE* src, BYTE* dst, size_t count);
+
+// Averages each factor x factor block of a width x height index image into
+// one 32-bit pixel, rows of width / factor pixels dstStride bytes apart.
+// Gives the same bytes as ExpandIndices32 followed by BoxDownscale, without
+// expanding the full image.
+VOID DownscaleIndices32(const UINT32* lut, const BYTE* src, INT32 width, INT32 height, INT32 factor, BYTE* dst, size_t dstStride);
@@ -0,0 +1,331 @@
+#include "PixelUnpack.h"
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define PIXEL_UNPACK_SIMD
+#include <immintrin.h>
+#endif
+
+
+// Shift and width of the B, G, R and A channels of a 16-bit format, a
+// width of 0 is opaque.
+struct PIXEL_LAYOUT16 {
+	INT32 Shift[4];
+	INT32 Bits[4];
+};
+
+
+static const PIXEL_LAYOUT16 g_layoutR5G6B5 = { { 0, 5, 11, 0 }, { 5, 6, 5, 0 } };
+static const PIXEL_LAYOUT16 g_layoutX1R5G5B5 = { { 0, 5, 10, 0 }, { 5, 5, 5, 0 } };
+static const PIXEL_LAYOUT16 g_layoutA1R5G5B5 = { { 0, 5, 10, 15 }, { 5, 5, 5, 1 } };
+static const PIXEL_LAYOUT16 g_layoutA4R4G4B4 = { { 0, 4, 8, 12 }, { 4, 4, 4, 4 } };
+static const PIXEL_LAYOUT16 g_layoutA8L8 = { { 0, 0, 0, 8 }, { 8, 8, 8, 8 } };
+
+
+static const PIXEL_LAYOUT16* GetLayout16(DWORD format) {
+	switch (format) {
+		case PIXEL_FORMAT_R5G6B5: {
+			return &g_layoutR5G6B5;
+		}
+		case PIXEL_FORMAT_X1R5G5B5: {
+			return &g_layoutX1R5G5B5;
+		}
+		case PIXEL_FORMAT_A1R5G5B5: {
+			return &g_layoutA1R5G5B5;
+		}
+		case PIXEL_FORMAT_A4R4G4B4: {
+			return &g_layoutA4R4G4B4;
+		}
+		case PIXEL_FORMAT_A8L8: {
+			return &g_layoutA8L8;
+		}
+	}
+
+	return NULL;
+}
+
+
+INT32 GetPixelFormatSize(DWORD format) {
+	switch (format) {
+		case PIXEL_FORMAT_L8: {
+			return 1;
+		}
+		case PIXEL_FORMAT_R5G6B5:
+		case PIXEL_FORMAT_X1R5G5B5:
+		case PIXEL_FORMAT_A1R5G5B5:
+		case PIXEL_FORMAT_A4R4G4B4:
+		case PIXEL_FORMAT_A8L8: {
+			return 2;
+		}
+		case PIXEL_FORMAT_R8G8B8: {
+			return 3;
+		}
+		case PIXEL_FORMAT_A8R8G8B8:
+		case PIXEL_FORMAT_X8R8G8B8:
+		case PIXEL_FORMAT_A8B8G8R8:
+		case PIXEL_FORMAT_X8B8G8R8: {
+			return 4;
+		}
+	}
+
+	return 0;
+}
+
+
+//
+// Scalar
+//
+
+static BYTE Widen(UINT32 value, INT32 shift, INT32 bits) {
+	if (bits == 0) {
+		return 0xFF;
+	}
+
+	UINT32 channel = (value >> shift) & ((1u << bits) - 1);
+
+	if (bits == 1) {
+		return (BYTE)(channel * 0xFF);
+	}
+
+	return (BYTE)((channel << (8 - bits)) | (channel >> (2 * bits - 8)));
+}
+
+
+static VOID UnpackPixelsScalar(const BYTE* src, DWORD format, BYTE* dst, size_t count) {
+	const PIXEL_LAYOUT16* layout = GetLayout16(format);
+	INT32 pixelSize = GetPixelFormatSize(format);
+
+	for (size_t i = 0; i < count; i++) {
+		switch (format) {
+			case PIXEL_FORMAT_L8: {
+				dst[0] = src[0];
+				dst[1] = src[0];
+				dst[2] = src[0];
+				dst[3] = 0xFF;
+				break;
+			}
+			case PIXEL_FORMAT_R8G8B8: {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				dst[3] = 0xFF;
+				break;
+			}
+			case PIXEL_FORMAT_A8R8G8B8:
+			case PIXEL_FORMAT_X8R8G8B8: {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				dst[3] = format == PIXEL_FORMAT_A8R8G8B8 ? src[3] : 0xFF;
+				break;
+			}
+			case PIXEL_FORMAT_A8B8G8R8:
+			case PIXEL_FORMAT_X8B8G8R8: {
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = format == PIXEL_FORMAT_A8B8G8R8 ? src[3] : 0xFF;
+				break;
+			}
+			default: {
+				UINT32 value = *(const UINT16*)src;
+
+				dst[0] = Widen(value, layout->Shift[0], layout->Bits[0]);
+				dst[1] = Widen(value, layout->Shift[1], layout->Bits[1]);
+				dst[2] = Widen(value, layout->Shift[2], layout->Bits[2]);
+				dst[3] = Widen(value, layout->Shift[3], layout->Bits[3]);
+				break;
+			}
+		}
+
+		src += pixelSize;
+		dst += 4;
+	}
+}
+
+
+#ifdef PIXEL_UNPACK_SIMD
+
+//
+// SSE2 / SSSE3
+//
+
+// Same as Widen for eight 16-bit pixels, one channel per 16-bit lane.
+static __m128i WidenSSE2(__m128i pixels, INT32 shift, INT32 bits) {
+	if (bits == 0) {
+		return _mm_set1_epi16(0xFF);
+	}
+
+	__m128i channel = _mm_and_si128(_mm_srl_epi16(pixels, _mm_cvtsi32_si128(shift)), _mm_set1_epi16((short)((1 << bits) - 1)));
+
+	if (bits == 1) {
+		return _mm_mullo_epi16(channel, _mm_set1_epi16(0xFF));
+	}
+
+	return _mm_or_si128(_mm_sll_epi16(channel, _mm_cvtsi32_si128(8 - bits)), _mm_srl_epi16(channel, _mm_cvtsi32_si128(2 * bits - 8)));
+}
+
+
+static VOID Unpack16SSE2(const BYTE* src, DWORD format, BYTE* dst, size_t count) {
+	const PIXEL_LAYOUT16* layout = GetLayout16(format);
+
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 2));
+
+		__m128i b = WidenSSE2(pixels, layout->Shift[0], layout->Bits[0]);
+		__m128i g = WidenSSE2(pixels, layout->Shift[1], layout->Bits[1]);
+		__m128i r = WidenSSE2(pixels, layout->Shift[2], layout->Bits[2]);
+		__m128i a = WidenSSE2(pixels, layout->Shift[3], layout->Bits[3]);
+
+		__m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+		__m128i ra = _mm_or_si128(r, _mm_slli_epi16(a, 8));
+
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_unpackhi_epi16(bg, ra));
+	}
+
+	UnpackPixelsScalar(src + i * 2, format, dst + i * 4, count - i);
+}
+
+
+static VOID UnpackL8SSE2(const BYTE* src, BYTE* dst, size_t count) {
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i luminance = _mm_loadu_si128((const __m128i*)(src + i));
+
+		// L, L pairs and L, 0xFF pairs, interleaved to L, L, L, 0xFF
+		__m128i low = _mm_unpacklo_epi8(luminance, luminance);
+		__m128i high = _mm_unpackhi_epi8(luminance, luminance);
+		__m128i lowAlpha = _mm_unpacklo_epi8(luminance, opaque);
+		__m128i highAlpha = _mm_unpackhi_epi8(luminance, opaque);
+
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi16(low, lowAlpha));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_unpackhi_epi16(low, lowAlpha));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 32), _mm_unpacklo_epi16(high, highAlpha));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 48), _mm_unpackhi_epi16(high, highAlpha));
+	}
+
+	UnpackPixelsScalar(src + i, PIXEL_FORMAT_L8, dst + i * 4, count - i);
+}
+
+
+// X8R8G8B8 only sets alpha, the B8G8R8 formats also swap red and blue.
+static VOID Unpack32SSE2(const BYTE* src, DWORD format, BYTE* dst, size_t count) {
+	const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i low = _mm_set1_epi32(0xFF);
+	const __m128i alpha = _mm_set1_epi32(format == PIXEL_FORMAT_A8B8G8R8 ? 0 : (int)0xFF000000);
+
+	BOOL swap = format != PIXEL_FORMAT_X8R8G8B8;
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 4));
+
+		if (swap) {
+			pixels = _mm_or_si128(
+				_mm_and_si128(pixels, greenAlpha),
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16), low), _mm_slli_epi32(_mm_and_si128(pixels, low), 16)));
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(pixels, alpha));
+	}
+
+	UnpackPixelsScalar(src + i * 4, format, dst + i * 4, count - i);
+}
+
+
+static VOID Unpack24SSSE3(const BYTE* src, BYTE* dst, size_t count) {
+	const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+	size_t i = 0;
+
+	// Each load reads 16 bytes of which 12 are used, stop while the 4 byte
+	// overhang still lands inside the input.
+	for (; count - i >= 6; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 3));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, spread), alpha));
+	}
+
+	UnpackPixelsScalar(src + i * 3, PIXEL_FORMAT_R8G8B8, dst + i * 4, count - i);
+}
+
+#endif
+
+
+VOID UnpackPixels(const BYTE* src, DWORD format, BYTE* dst, size_t count) {
+	if (format == PIXEL_FORMAT_A8R8G8B8) {
+		memcpy(dst, src, count * 4);
+		return;
+	}
+
+#ifdef PIXEL_UNPACK_SIMD
+	DWORD features = GetCpuFeatures();
+
+	switch (format) {
+		case PIXEL_FORMAT_L8: {
+			if (features & CPU_SSE2) {
+				UnpackL8SSE2(src, dst, count);
+				return;
+			}
+			break;
+		}
+		case PIXEL_FORMAT_R8G8B8: {
+			if (features & CPU_SSSE3) {
+				Unpack24SSSE3(src, dst, count);
+				return;
+			}
+			break;
+		}
+		case PIXEL_FORMAT_X8R8G8B8:
+		case PIXEL_FORMAT_A8B8G8R8:
+		case PIXEL_FORMAT_X8B8G8R8: {
+			if (features & CPU_SSE2) {
+				Unpack32SSE2(src, format, dst, count);
+				return;
+			}
+			break;
+		}
+		default: {
+			if (features & CPU_SSE2) {
+				Unpack16SSE2(src, format, dst, count);
+				return;
+			}
+			break;
+		}
+	}
+#endif
+
+	UnpackPixelsScalar(src, format, dst, count);
+}
+
+
+VOID UnpackPixelsRGB(const BYTE* src, DWORD format, BYTE* dst, size_t count) {
+	INT32 pixelSize = GetPixelFormatSize(format);
+
+	// Through UnpackPixels a stack buffer at a time
+	UINT32 pixels[256];
+
+	while (count > 0) {
+		size_t chunk = min(count, ARRAYSIZE(pixels));
+
+		UnpackPixels(src, format, (BYTE*)pixels, chunk);
+
+		for (size_t i = 0; i < chunk; i++) {
+			dst[0] = (BYTE)(pixels[i] >> 16);
+			dst[1] = (BYTE)(pixels[i] >> 8);
+			dst[2] = (BYTE)(pixels[i]);
+
+			dst += 3;
+		}
+
+		src += chunk * pixelSize;
+		count -= chunk;
+	}
+}
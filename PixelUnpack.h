@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// Uncompressed DDS layouts, numbered like the matching D3DFORMAT. Names
+// list the channels from the most significant bit down.
+enum {
+	PIXEL_FORMAT_R8G8B8 = 20,
+	PIXEL_FORMAT_A8R8G8B8 = 21,
+	PIXEL_FORMAT_X8R8G8B8 = 22,
+	PIXEL_FORMAT_R5G6B5 = 23,
+	PIXEL_FORMAT_X1R5G5B5 = 24,
+	PIXEL_FORMAT_A1R5G5B5 = 25,
+	PIXEL_FORMAT_A4R4G4B4 = 26,
+	PIXEL_FORMAT_A8B8G8R8 = 32,
+	PIXEL_FORMAT_X8B8G8R8 = 33,
+	PIXEL_FORMAT_L8 = 50,
+	PIXEL_FORMAT_A8L8 = 51
+};
+
+
+// Bytes per pixel, 0 if the format is not one of the above.
+INT32 GetPixelFormatSize(DWORD format);
+
+// Converts count pixels to 32-bit B, G, R, A. Narrow channels are widened
+// by repeating their top bits, formats without alpha come out opaque and
+// luminance is spread to all three colors. A8R8G8B8 is already in that
+// layout and is copied as is.
+VOID UnpackPixels(const BYTE* src, DWORD format, BYTE* dst, size_t count);
+
+// Same as UnpackPixels with 24-bit R, G, B output, alpha is dropped.
+VOID UnpackPixelsRGB(const BYTE* src, DWORD format, BYTE* dst, size_t count);
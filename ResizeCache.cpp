@@ -0,0 +1,193 @@
+#include "ResizeCache.h"
+
+
+// Thumbnails come in a handful of sizes, a few entries cover the usual
+// mix of source sizes per folder
+#define RESIZE_CACHE_ENTRIES 8
+
+
+struct RESIZE_CACHE_ENTRY {
+	STBIR_RESIZE Resize;
+	INT32 Width;
+	INT32 Height;
+	INT32 NewWidth;
+	INT32 NewHeight;
+	stbir_pixel_layout Layout;
+	BOOL Valid;
+	BOOL InUse;
+	ULONGLONG LastUse;
+};
+
+typedef RESIZE_CACHE_ENTRY* PRESIZE_CACHE_ENTRY;
+
+
+static SRWLOCK g_lock = SRWLOCK_INIT;
+static RESIZE_CACHE_ENTRY g_entries[RESIZE_CACHE_ENTRIES];
+static ULONGLONG g_useCounter = 0;
+
+
+//
+// Cache slots
+//
+
+// Claims an idle entry with the given geometry, NULL on a miss. The caller
+// owns the entry's samplers until ReleaseEntry.
+static PRESIZE_CACHE_ENTRY AcquireEntry(INT32 width, INT32 height, INT32 newWidth, INT32 newHeight, stbir_pixel_layout layout) {
+	PRESIZE_CACHE_ENTRY result = NULL;
+
+	AcquireSRWLockExclusive(&g_lock);
+
+	for (INT32 i = 0; i < RESIZE_CACHE_ENTRIES; i++) {
+		PRESIZE_CACHE_ENTRY entry = &g_entries[i];
+
+		if (entry->Valid && !entry->InUse &&
+			entry->Width == width && entry->Height == height &&
+			entry->NewWidth == newWidth && entry->NewHeight == newHeight &&
+			entry->Layout == layout) {
+			entry->InUse = TRUE;
+			result = entry;
+			break;
+		}
+	}
+
+	ReleaseSRWLockExclusive(&g_lock);
+
+	return result;
+}
+
+static VOID ReleaseEntry(PRESIZE_CACHE_ENTRY entry) {
+	AcquireSRWLockExclusive(&g_lock);
+
+	entry->InUse = FALSE;
+	entry->LastUse = ++g_useCounter;
+
+	ReleaseSRWLockExclusive(&g_lock);
+}
+
+// Moves freshly built samplers into the cache, replacing the least recently
+// used idle entry. They are freed instead if every entry is busy.
+static VOID InsertEntry(const STBIR_RESIZE* resize, INT32 width, INT32 height, INT32 newWidth, INT32 newHeight, stbir_pixel_layout layout) {
+	STBIR_RESIZE evicted;
+	BOOL hasEvicted = FALSE;
+	BOOL inserted = FALSE;
+
+	AcquireSRWLockExclusive(&g_lock);
+
+	PRESIZE_CACHE_ENTRY victim = NULL;
+
+	for (INT32 i = 0; i < RESIZE_CACHE_ENTRIES; i++) {
+		PRESIZE_CACHE_ENTRY entry = &g_entries[i];
+
+		if (!entry->Valid) {
+			victim = entry;
+			break;
+		}
+
+		if (!entry->InUse && (victim == NULL || entry->LastUse < victim->LastUse)) {
+			victim = entry;
+		}
+	}
+
+	if (victim != NULL) {
+		if (victim->Valid) {
+			evicted = victim->Resize;
+			hasEvicted = TRUE;
+		}
+
+		victim->Resize = *resize;
+		victim->Width = width;
+		victim->Height = height;
+		victim->NewWidth = newWidth;
+		victim->NewHeight = newHeight;
+		victim->Layout = layout;
+		victim->Valid = TRUE;
+		victim->InUse = FALSE;
+		victim->LastUse = ++g_useCounter;
+		inserted = TRUE;
+	}
+
+	ReleaseSRWLockExclusive(&g_lock);
+
+	// Sampler memory is released outside the lock
+	if (hasEvicted) {
+		stbir_free_samplers(&evicted);
+	}
+
+	if (!inserted) {
+		STBIR_RESIZE unused = *resize;
+		stbir_free_samplers(&unused);
+	}
+}
+
+
+//
+// Resizing
+//
+
+// Input rows come from input or, if given, from inputRows, which is set on
+// every call as cached samplers may have been built for either.
+static HRESULT Resize(const BYTE* input, INT32 inputStride, stbir_input_callback* inputRows, PVOID context,
+	INT32 width, INT32 height, BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride, stbir_pixel_layout layout) {
+	PRESIZE_CACHE_ENTRY entry = AcquireEntry(width, height, newWidth, newHeight, layout);
+
+	if (entry != NULL) {
+		// Samplers only hold the geometry, the buffers are swapped per call
+		stbir_set_buffer_ptrs(&entry->Resize, input, inputStride, output, outputStride);
+		stbir_set_pixel_callbacks(&entry->Resize, inputRows, NULL);
+		stbir_set_user_data(&entry->Resize, context);
+
+		int ok = stbir_resize_extended(&entry->Resize);
+
+		ReleaseEntry(entry);
+
+		return ok ? S_OK : E_FAIL;
+	}
+
+	STBIR_RESIZE resize;
+
+	stbir_resize_init(&resize, input, width, height, inputStride, output, newWidth, newHeight, outputStride,
+		layout, STBIR_TYPE_UINT8);
+	stbir_set_edgemodes(&resize, STBIR_EDGE_ZERO, STBIR_EDGE_ZERO);
+	stbir_set_filters(&resize, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT);
+	stbir_set_pixel_callbacks(&resize, inputRows, NULL);
+	stbir_set_user_data(&resize, context);
+
+	if (!stbir_build_samplers(&resize)) {
+		return E_OUTOFMEMORY;
+	}
+
+	if (!stbir_resize_extended(&resize)) {
+		stbir_free_samplers(&resize);
+		return E_FAIL;
+	}
+
+	InsertEntry(&resize, width, height, newWidth, newHeight, layout);
+
+	return S_OK;
+}
+
+
+//
+// Public API
+//
+
+HRESULT CachedResize(const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride, stbir_pixel_layout layout) {
+	return Resize(input, inputStride, NULL, NULL, width, height, output, newWidth, newHeight, outputStride, layout);
+}
+
+HRESULT CachedResizeRows(stbir_input_callback* inputRows, PVOID context, INT32 width, INT32 height,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride, stbir_pixel_layout layout) {
+	return Resize(NULL, 0, inputRows, context, width, height, output, newWidth, newHeight, outputStride, layout);
+}
+
+VOID FreeResizeCache() {
+	for (INT32 i = 0; i < RESIZE_CACHE_ENTRIES; i++) {
+		PRESIZE_CACHE_ENTRY entry = &g_entries[i];
+
+		if (entry->Valid) {
+			stbir_free_samplers(&entry->Resize);
+			entry->Valid = FALSE;
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Windows.h>
+#include "stb_image_resize2.h"
+
+
+// Resizes 8-bit pixels with zero edges and the default filter, the same as
+// a one-shot stbir_resize. Samplers are kept per source size, target size
+// and layout, so repeated thumbnails of one geometry skip the filter setup.
+// Safe to call from several threads.
+HRESULT CachedResize(const BYTE* input, INT32 width, INT32 height, INT32 inputStride,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride, stbir_pixel_layout layout);
+
+// Same, with the input produced on demand: inputRows is called with the
+// context for each span of a row the filter reaches, so only a few rows are
+// ever materialized. Row pixels are in the given layout.
+HRESULT CachedResizeRows(stbir_input_callback* inputRows, PVOID context, INT32 width, INT32 height,
+	BYTE* output, INT32 newWidth, INT32 newHeight, INT32 outputStride, stbir_pixel_layout layout);
+
+// Releases all cached samplers. Only call when no resize can be running,
+// i.e. when the module is unloaded.
+VOID FreeResizeCache();
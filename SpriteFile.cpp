@@ -1,4 +1,6 @@
 #include "SpriteFile.h"
+#include "StreamReader.h"
+#include "Arena.h"
 
 
 #ifdef _DEBUG
@@ -10,143 +12,233 @@
 #endif
 
 
-static HRESULT ReadBytes(IStream* stream, PVOID buffer, ULONG count) {
+// Smallest frame a file can hold, the frame type, its header and one pixel
+#define SPRITE_MIN_FRAME_SIZE (sizeof(INT32) + sizeof(SPRITE_FRAME_HEADER) + 1)
+
+// Frame index entries or frame pointers allocated before any frame has been
+// read
+#define SPRITE_FRAMES_INITIAL_CAPACITY 4096
+
+
+HRESULT ReadSpriteFileHeader(PSTREAM_READER reader, SPRITE_FILE_HEADER* header) {
 	HRESULT hr;
-	ULONG read;
 
-	hr = stream->Read(buffer, count, &read);
+	hr = ReadInt32(reader, &header->ID);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	return S_OK;
-}
+	if (header->ID != 0x50534449) {
+		return E_UNEXPECTED;
+	}
 
+	hr = ReadInt32(reader, &header->Version);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-static HRESULT ReadUInt8(IStream* stream, BYTE* result) {
-	HRESULT hr;
-	BYTE buffer;
-	ULONG read;
+	if (header->Version != 2) {
+		return E_UNEXPECTED;
+	}
 
-	hr = stream->Read(&buffer, sizeof(BYTE), &read);
+	hr = ReadInt32(reader, &header->Type);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	hr = ReadInt32(reader, &header->TexFormat);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	return S_OK;
-}
+	hr = ReadFloat(reader, &header->BoundingRadius);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
+	hr = ReadInt32(reader, &header->Width);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-static HRESULT ReadInt16(IStream* stream, INT16* result) {
-	HRESULT hr;
-	INT16 buffer;
-	ULONG read;
+	hr = ReadInt32(reader, &header->Height);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	hr = ReadInt32(reader, &header->FrameCount);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	if (header->FrameCount < 1) {
+		return E_UNEXPECTED;
+	}
+
+	hr = ReadFloat(reader, &header->BeamLength);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	hr = stream->Read(&buffer, sizeof(INT16), &read);
+	hr = ReadInt32(reader, &header->SyncType);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	// A frame count the rest of the input cannot hold is rejected before
+	// the frame array is allocated
+	hr = CheckRemainingBytes(reader, (ULONGLONG)header->FrameCount * SPRITE_MIN_FRAME_SIZE);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
 	return S_OK;
 }
 
 
-static HRESULT ReadInt32(IStream* stream, INT32* result) {
+HRESULT ReadSpritePaletteCount(PSTREAM_READER reader, INT16* result) {
 	HRESULT hr;
-	INT32 buffer;
-	ULONG read;
+	INT16 count;
+
+	hr = ReadInt16(reader, &count);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	if (count < 1 || count > 256) {
+		return E_UNEXPECTED;
+	}
 
-	hr = stream->Read(&buffer, sizeof(INT32), &read);
+	hr = CheckRemainingBytes(reader, (ULONGLONG)count * sizeof(COLOR24));
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	*result = count;
 
 	return S_OK;
 }
 
 
-static HRESULT ReadFloat(IStream* stream, float* result) {
+HRESULT ReadSpriteFrameType(PSTREAM_READER reader, INT32* result) {
 	HRESULT hr;
-	float buffer;
-	ULONG read;
+	INT32 type;
 
-	hr = stream->Read(&buffer, sizeof(float), &read);
+	hr = ReadInt32(reader, &type);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	if (type != SPR_SINGLE && type != SPR_GROUP) {
+		return E_UNEXPECTED;
+	}
+
+	*result = type;
 
 	return S_OK;
 }
 
 
-static HRESULT LoadFrameSingle(IStream* stream, PSPRITE_FRAME_SINGLE* result) {
+HRESULT ReadSpriteGroupCount(PSTREAM_READER reader, INT32* result) {
 	HRESULT hr;
+	INT32 count;
 
-	PSPRITE_FRAME_SINGLE frame = (PSPRITE_FRAME_SINGLE)malloc(sizeof(SPRITE_FRAME_SINGLE));
+	hr = ReadInt32(reader, &count);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	if (frame == NULL) {
-		return E_OUTOFMEMORY;
+	if (count < 1) {
+		return E_UNEXPECTED;
 	}
 
-	memset(frame, 0, sizeof(SPRITE_FRAME_SINGLE));
+	// Each group frame has an interval and at least a header and one pixel
+	hr = CheckRemainingBytes(reader, (ULONGLONG)count * (sizeof(float) + sizeof(SPRITE_FRAME_HEADER) + 1));
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	*result = count;
+
+	return S_OK;
+}
+
 
-	hr = ReadInt32(stream, &frame->Header.Origin[0]);
+HRESULT ReadSpriteFrameHeader(PSTREAM_READER reader, SPRITE_FRAME_HEADER* header) {
+	HRESULT hr;
+
+	hr = ReadInt32(reader, &header->Origin[0]);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &frame->Header.Origin[1]);
+	hr = ReadInt32(reader, &header->Origin[1]);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &frame->Header.Width);
+	hr = ReadInt32(reader, &header->Width);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
-	if (frame->Header.Width < 1) {
-		free(frame);
+	if (header->Width < 1) {
 		return E_UNEXPECTED;
 	}
 
-	hr = ReadInt32(stream, &frame->Header.Height);
+	hr = ReadInt32(reader, &header->Height);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
-	if (frame->Header.Height < 1) {
-		free(frame);
+	if (header->Height < 1) {
 		return E_UNEXPECTED;
 	}
 
+	hr = CheckRemainingBytes(reader, (ULONGLONG)header->Width * (ULONGLONG)header->Height);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	return S_OK;
+}
+
+
+// Without loadPixels only the header is read, Pixels stays NULL and the
+// reader is left at the start of the pixel data.
+static HRESULT LoadFrameSingle(PSTREAM_READER reader, PARENA arena, BOOL loadPixels, PSPRITE_FRAME_SINGLE* result) {
+	HRESULT hr;
+
+	PSPRITE_FRAME_SINGLE frame = (PSPRITE_FRAME_SINGLE)ArenaAlloc(arena, sizeof(SPRITE_FRAME_SINGLE));
+
+	if (frame == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	memset(frame, 0, sizeof(SPRITE_FRAME_SINGLE));
+
+	hr = ReadSpriteFrameHeader(reader, &frame->Header);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	if (!loadPixels) {
+		*result = frame;
+		return S_OK;
+	}
+
 	size_t dataSize = (size_t)frame->Header.Width * (size_t)frame->Header.Height;
 
-	frame->Pixels = (PBYTE)malloc(dataSize);
+	frame->Pixels = (PBYTE)ArenaAlloc(arena, dataSize);
 
 	if (frame->Pixels == NULL) {
-		free(frame);
 		return E_OUTOFMEMORY;
 	}
 
 	memset(frame->Pixels, 0, dataSize);
 
-	hr = ReadBytes(stream, frame->Pixels, (ULONG)dataSize);
+	hr = ReadBytes(reader, frame->Pixels, (ULONG)dataSize);
 	if (FAILED(hr)) {
-		free(frame->Pixels);
-		free(frame);
 		return hr;
 	}
 
@@ -156,10 +248,70 @@ static HRESULT LoadFrameSingle(IStream* stream, PSPRITE_FRAME_SINGLE* result) {
 }
 
 
-static HRESULT LoadFrameGroup(IStream* stream, PSPRITE_FRAME_GROUP* result) {
+static HRESULT SkipFrameSingle(PSTREAM_READER reader) {
 	HRESULT hr;
+	SPRITE_FRAME_HEADER header;
+
+	hr = ReadSpriteFrameHeader(reader, &header);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	PSPRITE_FRAME_GROUP group = (PSPRITE_FRAME_GROUP)malloc(sizeof(SPRITE_FRAME_GROUP));
+	return SkipBytes(reader, (LONGLONG)header.Width * (LONGLONG)header.Height);
+}
+
+
+// The group count is only checked against the stream size when that is
+// known, so the array grows as the intervals turn up rather than being
+// sized by the count up front.
+static HRESULT ReadGroupIntervals(PSTREAM_READER reader, PARENA arena, INT32 count, float** result) {
+	HRESULT hr;
+
+	INT32 capacity = min(count, SPRITE_FRAMES_INITIAL_CAPACITY);
+	INT32 read = 0;
+
+	float* intervals = (float*)ArenaAlloc(arena, sizeof(float) * (size_t)capacity);
+
+	if (intervals == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	while (read < count) {
+		if (read == capacity) {
+			capacity = (INT32)min((INT64)capacity * 2, (INT64)count);
+
+			float* grown = (float*)ArenaAlloc(arena, sizeof(float) * (size_t)capacity);
+
+			if (grown == NULL) {
+				return E_OUTOFMEMORY;
+			}
+
+			memcpy(grown, intervals, sizeof(float) * (size_t)read);
+
+			intervals = grown;
+		}
+
+		hr = ReadBytes(reader, &intervals[read], (ULONG)(sizeof(float) * (size_t)(capacity - read)));
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		read = capacity;
+	}
+
+	*result = intervals;
+
+	return S_OK;
+}
+
+
+// When firstOnly is set only the first sub-frame is read, the remaining
+// entries of group->Frames are left NULL and nothing after it is parsed.
+// loadPixels is passed on to LoadFrameSingle and requires firstOnly if FALSE.
+static HRESULT LoadFrameGroup(PSTREAM_READER reader, PARENA arena, BOOL firstOnly, BOOL loadPixels, PSPRITE_FRAME_GROUP* result) {
+	HRESULT hr;
+
+	PSPRITE_FRAME_GROUP group = (PSPRITE_FRAME_GROUP)ArenaAlloc(arena, sizeof(SPRITE_FRAME_GROUP));
 
 	if (group == NULL) {
 		return E_OUTOFMEMORY;
@@ -171,39 +323,18 @@ static HRESULT LoadFrameGroup(IStream* stream, PSPRITE_FRAME_GROUP* result) {
 	// Header
 	//
 
-	hr = ReadInt32(stream, &group->FrameCount);
+	hr = ReadSpriteGroupCount(reader, &group->FrameCount);
 	if (FAILED(hr)) {
-		free(group);
 		return hr;
 	}
 
-	if (group->FrameCount < 1) {
-		free(group);
-		return E_UNEXPECTED;
-	}
-
 	//
 	// Intervals
 	//
 
-	size_t intervalArraySize = sizeof(float) * (size_t)group->FrameCount;
-
-	group->Intervals = (float*)malloc(intervalArraySize);
-
-	if (group->Intervals == NULL) {
-		free(group);
-		return E_OUTOFMEMORY;
-	}
-
-	memset(group->Intervals, 0, intervalArraySize);
-
-	for (int i = 0; i < group->FrameCount; i++) {
-		hr = ReadFloat(stream, &group->Intervals[i]);
-		if (FAILED(hr)) {
-			free(group->Intervals);
-			free(group);
-			return hr;
-		}
+	hr = ReadGroupIntervals(reader, arena, group->FrameCount, &group->Intervals);
+	if (FAILED(hr)) {
+		return hr;
 	}
 
 	//
@@ -212,22 +343,19 @@ static HRESULT LoadFrameGroup(IStream* stream, PSPRITE_FRAME_GROUP* result) {
 
 	size_t frameArraySize = sizeof(PSPRITE_FRAME_SINGLE) * (size_t)group->FrameCount;
 
-	group->Frames = (PSPRITE_FRAME_SINGLE*)malloc(frameArraySize);
+	group->Frames = (PSPRITE_FRAME_SINGLE*)ArenaAlloc(arena, frameArraySize);
 
 	if (group->Frames == NULL) {
-		free(group->Intervals);
-		free(group);
 		return E_OUTOFMEMORY;
 	}
 
 	memset(group->Frames, 0, frameArraySize);
 
-	for (int i = 0; i < group->FrameCount; i++) {
-		hr = LoadFrameSingle(stream, &group->Frames[i]);
+	INT32 loadCount = firstOnly ? 1 : group->FrameCount;
+
+	for (int i = 0; i < loadCount; i++) {
+		hr = LoadFrameSingle(reader, arena, loadPixels, &group->Frames[i]);
 		if (FAILED(hr)) {
-			free(group->Intervals);
-			free(group->Frames);
-			free(group);
 			return hr;
 		}
 	}
@@ -238,10 +366,51 @@ static HRESULT LoadFrameGroup(IStream* stream, PSPRITE_FRAME_GROUP* result) {
 }
 
 
-static HRESULT LoadSpriteFrame(IStream* stream, PSPRITE_FRAME* result) {
+static HRESULT SkipSpriteFrame(PSTREAM_READER reader) {
+	HRESULT hr;
+	INT32 type;
+
+	hr = ReadSpriteFrameType(reader, &type);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	if (type == SPR_SINGLE) {
+		return SkipFrameSingle(reader);
+	}
+
+	if (type == SPR_GROUP) {
+		INT32 frameCount;
+
+		hr = ReadSpriteGroupCount(reader, &frameCount);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		// Intervals
+		hr = SkipBytes(reader, (LONGLONG)sizeof(float) * (LONGLONG)frameCount);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		for (INT32 i = 0; i < frameCount; i++) {
+			hr = SkipFrameSingle(reader);
+			if (FAILED(hr)) {
+				return hr;
+			}
+		}
+
+		return S_OK;
+	}
+
+	return E_UNEXPECTED;
+}
+
+
+static HRESULT LoadSpriteFrame(PSTREAM_READER reader, PARENA arena, BOOL firstOnly, BOOL loadPixels, PSPRITE_FRAME* result) {
 	HRESULT hr;
 
-	PSPRITE_FRAME frame = (PSPRITE_FRAME)malloc(sizeof(SPRITE_FRAME));
+	PSPRITE_FRAME frame = (PSPRITE_FRAME)ArenaAlloc(arena, sizeof(SPRITE_FRAME));
 
 	if (frame == NULL) {
 		return E_OUTOFMEMORY;
@@ -249,28 +418,24 @@ static HRESULT LoadSpriteFrame(IStream* stream, PSPRITE_FRAME* result) {
 
 	memset(frame, 0, sizeof(SPRITE_FRAME));
 
-	hr = ReadInt32(stream, &frame->Type);
+	hr = ReadSpriteFrameType(reader, &frame->Type);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
 	if (frame->Type == SPR_SINGLE) {
-		hr = LoadFrameSingle(stream, &frame->u.Single);
+		hr = LoadFrameSingle(reader, arena, loadPixels, &frame->u.Single);
 		if (FAILED(hr)) {
-			free(frame);
 			return hr;
 		}
 	}
 	else if (frame->Type == SPR_GROUP) {
-		hr = LoadFrameGroup(stream, &frame->u.Group);
+		hr = LoadFrameGroup(reader, arena, firstOnly, loadPixels, &frame->u.Group);
 		if (FAILED(hr)) {
-			free(frame);
 			return hr;
 		}
 	}
 	else {
-		free(frame);
 		return E_UNEXPECTED;
 	}
 
@@ -281,169 +446,391 @@ static HRESULT LoadSpriteFrame(IStream* stream, PSPRITE_FRAME* result) {
 
 
 VOID FreeSpriteFile(PSPRITE_FILE sprite) {
-	if (sprite->Palette.Colors) {
-		free(sprite->Palette.Colors);
-	}
-	if (sprite->Frames) {
-		for (INT32 i = 0; i < sprite->Header.FrameCount; i++) {
-			PSPRITE_FRAME frame = sprite->Frames[i];
-			if (frame) {
-				if (frame->Type == SPR_SINGLE) {
-					PSPRITE_FRAME_SINGLE single = frame->u.Single;
-					if (single) {
-						if (single->Pixels) {
-							free(single->Pixels);
-						}
-						free(single);
-					}
-				}
-				else if (frame->Type == SPR_GROUP) {
-					PSPRITE_FRAME_GROUP group = frame->u.Group;
-					if (group) {
-						if (group->Intervals) {
-							free(group->Intervals);
-						}
-						if (group->Frames) {
-							for (INT32 i = 0; i < group->FrameCount; i++) {
-								PSPRITE_FRAME_SINGLE singleFrame = group->Frames[i];
-								if (singleFrame) {
-									if (singleFrame->Pixels) {
-										free(singleFrame->Pixels);
-									}
-									free(singleFrame);
-								}
-							}
-							free(group->Frames);
-						}
-						free(group);
-					}
-				}
-				free(frame);
-			}
-		}
-		free(sprite->Frames);
+	// Everything, including the sprite itself, lives in the arena
+	FreeArena(sprite->Arena);
+}
+
+
+// Upper bound of the allocations needed for a frame array of slotCount
+// entries and frameCount loaded frames, based on the maximum frame size from
+// the file header and capped by the pixel bytes the input can actually hold.
+// Group frames or a grown array that exceed it make the arena chain a
+// further block.
+static size_t EstimateArenaSize(SPRITE_FILE_HEADER* header, INT32 slotCount, INT32 frameCount, ULONGLONG available) {
+	const UINT64 maxReserve = 64 * 1024 * 1024;
+	const UINT64 overhead = 16;
+
+	UINT64 pixels = 0;
+
+	if (header->Width > 0 && header->Height > 0) {
+		pixels = (UINT64)header->Width * (UINT64)header->Height;
 	}
-	free(sprite);
+
+	UINT64 frameSize = (sizeof(SPRITE_FRAME) + overhead) + (sizeof(SPRITE_FRAME_SINGLE) + overhead) + overhead;
+
+	UINT64 size = (sizeof(SPRITE_FILE) + overhead) + (256 * sizeof(COLOR24) + overhead);
+	size += (UINT64)slotCount * sizeof(PSPRITE_FRAME) + overhead;
+	size += (UINT64)frameCount * frameSize;
+	size += min((UINT64)frameCount * pixels, available);
+
+	return (size_t)min(size, maxReserve);
 }
 
 
-HRESULT LoadSpriteFile(IStream* stream, PSPRITE_FILE* result) {
-	HRESULT hr;
+// Grows sprite->Frames to count entries, the new ones are NULL.
+static HRESULT GrowSpriteFrames(PSPRITE_FILE sprite, INT32 count) {
+	size_t frameArraySize = sizeof(PSPRITE_FRAME) * (size_t)count;
 
-	PSPRITE_FILE sprite = (PSPRITE_FILE)malloc(sizeof(SPRITE_FILE));
+	PSPRITE_FRAME* frames = (PSPRITE_FRAME*)ArenaAlloc(sprite->Arena, frameArraySize);
 
-	if (sprite == NULL) {
+	if (frames == NULL) {
 		return E_OUTOFMEMORY;
 	}
 
-	memset(sprite, 0, sizeof(SPRITE_FILE));
+	memset(frames, 0, frameArraySize);
+
+	if (sprite->Count > 0) {
+		memcpy(frames, sprite->Frames, sizeof(PSPRITE_FRAME) * (size_t)sprite->Count);
+	}
+
+	sprite->Frames = frames;
+	sprite->Count = count;
+
+	return S_OK;
+}
+
+
+// Makes room for frame i of a sprite loaded frame by frame, doubling the
+// array so an untrusted frame count is only believed as far as frames turn up.
+static HRESULT ReserveSpriteFrame(PSPRITE_FILE sprite, INT32 i) {
+	if (i < sprite->Count) {
+		return S_OK;
+	}
+
+	return GrowSpriteFrames(sprite, (INT32)min((INT64)i * 2, (INT64)sprite->Header.FrameCount));
+}
+
+
+// The frame array starts with slotCount entries and the pixels of loadCount
+// frames are reserved for, both clamped to the header's frame count.
+static HRESULT LoadSpriteHeader(PSTREAM_READER reader, INT32 slotCount, INT32 loadCount, PSPRITE_FILE* result) {
+	HRESULT hr;
+
+	SPRITE_FILE_HEADER header;
+
+	hr = ReadSpriteFileHeader(reader, &header);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
 	//
-	// File Header
+	// Storage for everything we are about to load
 	//
 
-	hr = ReadInt32(stream, &sprite->Header.ID);
+	slotCount = min(slotCount, header.FrameCount);
+	loadCount = min(loadCount, header.FrameCount);
+
+	PARENA arena;
+
+	hr = CreateArena(EstimateArenaSize(&header, slotCount, loadCount, GetRemainingBytes(reader)), &arena);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
 		return hr;
 	}
 
-	if (sprite->Header.ID != 0x50534449) {
-		FreeSpriteFile(sprite);
-		return E_UNEXPECTED;
+	PSPRITE_FILE sprite = (PSPRITE_FILE)ArenaAlloc(arena, sizeof(SPRITE_FILE));
+
+	if (sprite == NULL) {
+		FreeArena(arena);
+		return E_OUTOFMEMORY;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Version);
+	memset(sprite, 0, sizeof(SPRITE_FILE));
+
+	sprite->Header = header;
+	sprite->Arena = arena;
+
+	//
+	// Palette
+	//
+
+	hr = ReadSpritePaletteCount(reader, &sprite->Palette.Count);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
+		FreeArena(arena);
 		return hr;
 	}
 
-	if (sprite->Header.Version != 2) {
-		FreeSpriteFile(sprite);
-		return E_UNEXPECTED;
+	size_t paletteSize = sprite->Palette.Count * sizeof(COLOR24);
+
+	sprite->Palette.Colors = (PCOLOR24)ArenaAlloc(arena, paletteSize);
+
+	if (sprite->Palette.Colors == NULL) {
+		FreeArena(arena);
+		return E_OUTOFMEMORY;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Type);
+	hr = ReadBytes(reader, sprite->Palette.Colors, (ULONG)paletteSize);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
+		FreeArena(arena);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.TexFormat);
+	//
+	// Frames
+	//
+
+	hr = GrowSpriteFrames(sprite, slotCount);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
+		FreeArena(arena);
 		return hr;
 	}
 
-	hr = ReadFloat(stream, &sprite->Header.BoundingRadius);
+	*result = sprite;
+
+	return S_OK;
+}
+
+
+HRESULT LoadSpriteFile(PSTREAM_READER reader, PSPRITE_FILE* result) {
+	HRESULT hr;
+	PSPRITE_FILE sprite;
+
+	hr = LoadSpriteHeader(reader, SPRITE_FRAMES_INITIAL_CAPACITY, MAXINT32, &sprite);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Width);
+	for (INT32 i = 0; i < sprite->Header.FrameCount; i++) {
+		hr = ReserveSpriteFrame(sprite, i);
+		if (FAILED(hr)) {
+			FreeSpriteFile(sprite);
+			return hr;
+		}
+
+		hr = LoadSpriteFrame(reader, sprite->Arena, FALSE, TRUE, &sprite->Frames[i]);
+		if (FAILED(hr)) {
+			FreeSpriteFile(sprite);
+			return hr;
+		}
+	}
+
+	*result = sprite;
+
+	return S_OK;
+}
+
+
+static HRESULT LoadSpriteFileFrameEx(PSTREAM_READER reader, INT32 frameIndex, BOOL loadPixels, PSPRITE_FILE* result) {
+	HRESULT hr;
+	PSPRITE_FILE sprite;
+
+	// Pixels that are not loaded now get a block of their own later, if at all
+	hr = LoadSpriteHeader(reader, 1, loadPixels ? 1 : 0, &sprite);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Height);
-	if (FAILED(hr)) {
+	if (frameIndex < 0 || frameIndex >= sprite->Header.FrameCount) {
 		FreeSpriteFile(sprite);
-		return hr;
+		return E_INVALIDARG;
+	}
+
+	if (frameIndex >= sprite->Count) {
+		hr = GrowSpriteFrames(sprite, frameIndex + 1);
+		if (FAILED(hr)) {
+			FreeSpriteFile(sprite);
+			return hr;
+		}
+	}
+
+	// Frames are variable-sized, walk over the preceding ones by their headers.
+	for (INT32 i = 0; i < frameIndex; i++) {
+		hr = SkipSpriteFrame(reader);
+		if (FAILED(hr)) {
+			FreeSpriteFile(sprite);
+			return hr;
+		}
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.FrameCount);
+	hr = LoadSpriteFrame(reader, sprite->Arena, TRUE, loadPixels, &sprite->Frames[frameIndex]);
 	if (FAILED(hr)) {
 		FreeSpriteFile(sprite);
 		return hr;
 	}
 
-	if (sprite->Header.FrameCount < 1) {
-		FreeSpriteFile(sprite);
+	*result = sprite;
+
+	return S_OK;
+}
+
+
+HRESULT LoadSpriteFileFrame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE* result) {
+	return LoadSpriteFileFrameEx(reader, frameIndex, TRUE, result);
+}
+
+
+HRESULT LocateSpriteFileFrame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE* result) {
+	return LoadSpriteFileFrameEx(reader, frameIndex, FALSE, result);
+}
+
+
+HRESULT ReadSpriteFramePixels(PSTREAM_READER reader, PSPRITE_FILE sprite, PSPRITE_FRAME_SINGLE frame) {
+	size_t dataSize = (size_t)frame->Header.Width * (size_t)frame->Header.Height;
+
+	frame->Pixels = (PBYTE)ArenaAlloc(sprite->Arena, dataSize);
+
+	if (frame->Pixels == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	return ReadBytes(reader, frame->Pixels, (ULONG)dataSize);
+}
+
+
+static HRESULT GrowSpriteFrameIndex(PSPRITE_FRAME_INDEX index, INT32* capacity) {
+	if (*capacity > MAXINT32 / 2) {
 		return E_UNEXPECTED;
 	}
 
-	hr = ReadFloat(stream, &sprite->Header.BeamLength);
+	INT32 newCapacity = *capacity * 2;
+
+	PSPRITE_FRAME_INDEX_ENTRY entries = (PSPRITE_FRAME_INDEX_ENTRY)ArenaAlloc(index->Arena, sizeof(SPRITE_FRAME_INDEX_ENTRY) * (size_t)newCapacity);
+
+	if (entries == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	memcpy(entries, index->Entries, sizeof(SPRITE_FRAME_INDEX_ENTRY) * (size_t)index->Count);
+
+	index->Entries = entries;
+	*capacity = newCapacity;
+
+	return S_OK;
+}
+
+
+static HRESULT IndexSpriteFrames(PSTREAM_READER reader, PSPRITE_FRAME_INDEX index) {
+	HRESULT hr;
+
+	// Groups are rare, start with one entry per frame and grow. The count is
+	// untrusted, so a large one is only believed as far as frames turn up.
+	INT32 capacity = min(index->Header.FrameCount, SPRITE_FRAMES_INITIAL_CAPACITY);
+
+	index->Entries = (PSPRITE_FRAME_INDEX_ENTRY)ArenaAlloc(index->Arena, sizeof(SPRITE_FRAME_INDEX_ENTRY) * (size_t)capacity);
+
+	if (index->Entries == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	for (INT32 i = 0; i < index->Header.FrameCount; i++) {
+		INT32 type;
+
+		hr = ReadSpriteFrameType(reader, &type);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		INT32 groupCount = 1;
+		float* intervals = NULL;
+
+		if (type == SPR_GROUP) {
+			hr = ReadSpriteGroupCount(reader, &groupCount);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			hr = ReadGroupIntervals(reader, index->Arena, groupCount, &intervals);
+			if (FAILED(hr)) {
+				return hr;
+			}
+		}
+
+		for (INT32 j = 0; j < groupCount; j++) {
+			if (index->Count == capacity) {
+				hr = GrowSpriteFrameIndex(index, &capacity);
+				if (FAILED(hr)) {
+					return hr;
+				}
+			}
+
+			PSPRITE_FRAME_INDEX_ENTRY entry = &index->Entries[index->Count];
+
+			hr = ReadSpriteFrameHeader(reader, &entry->Header);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			entry->Offset = TellReader(reader);
+			entry->Type = type;
+			entry->Frame = i;
+			entry->GroupIndex = j;
+			entry->Interval = intervals ? intervals[j] : 0.0f;
+
+			hr = SkipBytes(reader, (LONGLONG)entry->Header.Width * (LONGLONG)entry->Header.Height);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			index->Count++;
+		}
+	}
+
+	return S_OK;
+}
+
+
+HRESULT BuildSpriteFrameIndex(PSTREAM_READER reader, PSPRITE_FRAME_INDEX* result) {
+	HRESULT hr;
+
+	SPRITE_FILE_HEADER header;
+
+	hr = ReadSpriteFileHeader(reader, &header);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.SyncType);
+	PARENA arena;
+
+	size_t reserve = sizeof(SPRITE_FRAME_INDEX) + 256 * sizeof(COLOR24) + sizeof(SPRITE_FRAME_INDEX_ENTRY) * (size_t)min(header.FrameCount, SPRITE_FRAMES_INITIAL_CAPACITY);
+
+	hr = CreateArena(reserve, &arena);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
 		return hr;
 	}
 
+	PSPRITE_FRAME_INDEX index = (PSPRITE_FRAME_INDEX)ArenaAlloc(arena, sizeof(SPRITE_FRAME_INDEX));
+
+	if (index == NULL) {
+		FreeArena(arena);
+		return E_OUTOFMEMORY;
+	}
+
+	memset(index, 0, sizeof(SPRITE_FRAME_INDEX));
+
+	index->Header = header;
+	index->Arena = arena;
+
 	//
 	// Palette
 	//
 
-	hr = ReadInt16(stream, &sprite->Palette.Count);
+	hr = ReadSpritePaletteCount(reader, &index->Palette.Count);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
+		FreeArena(arena);
 		return hr;
 	}
 
-	if (sprite->Palette.Count < 1 || sprite->Palette.Count > 256) {
-		FreeSpriteFile(sprite);
-		return E_UNEXPECTED;
-	}
-
-	size_t paletteSize = sprite->Palette.Count * sizeof(COLOR24);
+	size_t paletteSize = index->Palette.Count * sizeof(COLOR24);
 
-	sprite->Palette.Colors = (PCOLOR24)malloc(paletteSize);
+	index->Palette.Colors = (PCOLOR24)ArenaAlloc(arena, paletteSize);
 
-	if (sprite->Palette.Colors == NULL) {
-		FreeSpriteFile(sprite);
+	if (index->Palette.Colors == NULL) {
+		FreeArena(arena);
 		return E_OUTOFMEMORY;
 	}
 
-	hr = ReadBytes(stream, sprite->Palette.Colors, (ULONG)paletteSize);
+	hr = ReadBytes(reader, index->Palette.Colors, (ULONG)paletteSize);
 	if (FAILED(hr)) {
-		FreeSpriteFile(sprite);
+		FreeArena(arena);
 		return hr;
 	}
 
@@ -451,24 +838,32 @@ HRESULT LoadSpriteFile(IStream* stream, PSPRITE_FILE* result) {
 	// Frames
 	//
 
-	size_t frameArraySize = sizeof(PSPRITE_FRAME) * (size_t)sprite->Header.FrameCount;
+	hr = IndexSpriteFrames(reader, index);
+	if (FAILED(hr)) {
+		FreeArena(arena);
+		return hr;
+	}
 
-	sprite->Frames = (PSPRITE_FRAME*)malloc(frameArraySize);
+	*result = index;
 
-	if (sprite->Frames == NULL) {
-		FreeSpriteFile(sprite);
-		return E_OUTOFMEMORY;
-	}
+	return S_OK;
+}
 
-	for (INT32 i = 0; i < sprite->Header.FrameCount; i++) {
-		hr = LoadSpriteFrame(stream, &sprite->Frames[i]);
-		if (FAILED(hr)) {
-			FreeSpriteFile(sprite);
-			return hr;
-		}
+
+VOID FreeSpriteFrameIndex(PSPRITE_FRAME_INDEX index) {
+	FreeArena(index->Arena);
+}
+
+
+HRESULT ReadIndexedFramePixels(PSTREAM_READER reader, PSPRITE_FRAME_INDEX_ENTRY entry, PBYTE pixels) {
+	HRESULT hr;
+
+	hr = SeekReader(reader, entry->Offset);
+	if (FAILED(hr)) {
+		return hr;
 	}
 
-	*result = sprite;
+	size_t dataSize = (size_t)entry->Header.Width * (size_t)entry->Header.Height;
 
-	return S_OK;
+	return ReadBytes(reader, pixels, (ULONG)dataSize);
 }
@@ -2,6 +2,9 @@
 
 #include <Windows.h>
 
+#include "StreamReader.h"
+#include "Arena.h"
+
 
 struct SPRITE_FILE_HEADER {
 	INT32 ID;
@@ -73,16 +76,84 @@ struct SPRITE_FRAME {
 typedef SPRITE_FRAME* PSPRITE_FRAME;
 
 
+// Frames has Count entries, Header.FrameCount of them once the whole file is
+// loaded.
 struct SPRITE_FILE {
 	SPRITE_FILE_HEADER Header;
 	SPRITE_PALETTE Palette;
+	INT32 Count;
 	PSPRITE_FRAME* Frames;
+	PARENA Arena;
 };
 
 typedef SPRITE_FILE* PSPRITE_FILE;
 
 
+// Location of one single frame (a standalone frame or a group member) in
+// the file. Offset points at the pixel data and is relative to where the
+// reader was started, normally the start of the file.
+struct SPRITE_FRAME_INDEX_ENTRY {
+	ULONGLONG Offset;
+	SPRITE_FRAME_HEADER Header;
+	INT32 Type;
+	INT32 Frame;
+	INT32 GroupIndex;
+	float Interval;
+};
+
+typedef SPRITE_FRAME_INDEX_ENTRY* PSPRITE_FRAME_INDEX_ENTRY;
+
+
+struct SPRITE_FRAME_INDEX {
+	SPRITE_FILE_HEADER Header;
+	SPRITE_PALETTE Palette;
+	INT32 Count;
+	PSPRITE_FRAME_INDEX_ENTRY Entries;
+	PARENA Arena;
+};
+
+typedef SPRITE_FRAME_INDEX* PSPRITE_FRAME_INDEX;
+
+
+// Validating parsers for the individual records of a sprite file, shared by
+// the loaders and by the mapped views.
+HRESULT ReadSpriteFileHeader(PSTREAM_READER reader, SPRITE_FILE_HEADER* header);
+
+HRESULT ReadSpritePaletteCount(PSTREAM_READER reader, INT16* result);
+
+HRESULT ReadSpriteFrameType(PSTREAM_READER reader, INT32* result);
+
+HRESULT ReadSpriteGroupCount(PSTREAM_READER reader, INT32* result);
+
+HRESULT ReadSpriteFrameHeader(PSTREAM_READER reader, SPRITE_FRAME_HEADER* header);
+
+
 VOID FreeSpriteFile(PSPRITE_FILE sprite);
 
-HRESULT LoadSpriteFile(IStream* stream, PSPRITE_FILE* result);
+HRESULT LoadSpriteFile(PSTREAM_READER reader, PSPRITE_FILE* result);
+
+// Loads the header, the palette and a single frame. Frames has frameIndex + 1
+// entries and only the last one is populated (and only the first sub-frame
+// if it is a group), the others are NULL. Nothing after the loaded frame is
+// parsed.
+HRESULT LoadSpriteFileFrame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE* result);
+
+// Same as LoadSpriteFileFrame without the pixels: the loaded frame has
+// Pixels NULL and the reader is left at the start of its pixel data, so the
+// caller can decide how to read them.
+HRESULT LocateSpriteFileFrame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE* result);
+
+// Reads the pixels of a frame from LocateSpriteFileFrame into the sprite,
+// the reader must not have moved since.
+HRESULT ReadSpriteFramePixels(PSTREAM_READER reader, PSPRITE_FILE sprite, PSPRITE_FRAME_SINGLE frame);
+
+// Records the location of every single frame, group members included, by
+// reading only the frame headers and seeking over the pixel data.
+HRESULT BuildSpriteFrameIndex(PSTREAM_READER reader, PSPRITE_FRAME_INDEX* result);
+
+VOID FreeSpriteFrameIndex(PSPRITE_FRAME_INDEX index);
+
+// Reads the pixels of one indexed frame with a single seek, pixels must hold
+// Width * Height bytes.
+HRESULT ReadIndexedFramePixels(PSTREAM_READER reader, PSPRITE_FRAME_INDEX_ENTRY entry, PBYTE pixels);
 
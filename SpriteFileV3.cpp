@@ -1,4 +1,10 @@
 #include "SpriteFileV3.h"
+#include "StreamReader.h"
+#include "Arena.h"
+#include "DxtDecode.h"
+#include "PixelUnpack.h"
+
+#include <dxgiformat.h>
 
 
 #ifdef _DEBUG
@@ -40,181 +46,377 @@ struct DDS_HEADER {
 };
 
 
-static HRESULT ReadBytes(IStream* stream, PVOID buffer, ULONG count) {
-	HRESULT hr;
-	ULONG read;
+// Follows DDS_HEADER when the FourCC is DX10
+struct DDS_HEADER_DXT10 {
+	DWORD dxgiFormat;
+	DWORD resourceDimension;
+	DWORD miscFlag;
+	DWORD arraySize;
+	DWORD miscFlags2;
+};
 
-	hr = stream->Read(buffer, count, &read);
-	if (FAILED(hr)) {
-		return hr;
-	}
 
-	return S_OK;
-}
+enum {
+	DDS_FOURCC_DX10 = 0x30315844,
+	DDS_FOURCC_ATI1 = 0x31495441,
+	DDS_FOURCC_ATI2 = 0x32495441,
+	DDS_DIMENSION_TEXTURE2D = 3,
+	DDS_MISC_TEXTURECUBE = 0x4,
+	DDPF_ALPHAPIXELS = 0x1,
+	DDPF_RGB = 0x40,
+	DDPF_LUMINANCE = 0x20000
+};
+
 
+// Every frame needs at least its DDS magic and header
+#define SPRITE_MIN_FRAME_SIZE_V3 (sizeof(DWORD) + sizeof(DDS_HEADER))
 
-static HRESULT ReadInt32(IStream* stream, INT32* result) {
+// Frame pointers allocated before any frame has been read
+#define SPRITE_FRAMES_INITIAL_CAPACITY_V3 4096
+
+
+static HRESULT ReadDdsHeader(PSTREAM_READER reader, DDS_HEADER* header) {
 	HRESULT hr;
-	INT32 buffer;
-	ULONG read;
 
-	hr = stream->Read(&buffer, sizeof(INT32), &read);
+	hr = ReadDword(reader, &header->dwSize);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	if (header->dwSize != 0x7C) {
+		return E_NOTIMPL;
+	}
 
-	return S_OK;
-}
+	hr = ReadDword(reader, &header->dwFlags);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
+	hr = ReadDword(reader, &header->dwHeight);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-static HRESULT ReadDword(IStream* stream, DWORD* result) {
-	HRESULT hr;
-	DWORD buffer;
-	ULONG read;
+	hr = ReadDword(reader, &header->dwWidth);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	hr = stream->Read(&buffer, sizeof(DWORD), &read);
+	hr = ReadDword(reader, &header->dwPitchOrLinearSize);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	hr = ReadDword(reader, &header->dwDepth);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	return S_OK;
-}
+	hr = ReadDword(reader, &header->dwMipMapCount);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	for (int i = 0; i < 11; i++) {
+		hr = ReadDword(reader, &header->dwReserved1[i]);
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
 
+	hr = ReadDword(reader, &header->ddspf.dwSize);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-static HRESULT ReadFloat(IStream* stream, float* result) {
-	HRESULT hr;
-	float buffer;
-	ULONG read;
+	if (header->ddspf.dwSize != 0x20) {
+		return E_NOTIMPL;
+	}
 
-	hr = stream->Read(&buffer, sizeof(float), &read);
+	hr = ReadDword(reader, &header->ddspf.dwFlags);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	*result = buffer;
+	hr = ReadDword(reader, &header->ddspf.dwFourCC);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	return S_OK;
-}
+	hr = ReadDword(reader, &header->ddspf.dwRGBBitCount);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
+	hr = ReadDword(reader, &header->ddspf.dwRBitMask);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-static HRESULT ReadDdsHeader(IStream* stream, DDS_HEADER* header) {
-	HRESULT hr;
+	hr = ReadDword(reader, &header->ddspf.dwGBitMask);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	hr = ReadDword(stream, &header->dwSize);
+	hr = ReadDword(reader, &header->ddspf.dwBBitMask);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	if (header->dwSize != 0x7C) {
-		return E_NOTIMPL;
+	hr = ReadDword(reader, &header->ddspf.dwABitMask);
+	if (FAILED(hr)) {
+		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwFlags);
+	hr = ReadDword(reader, &header->dwCaps);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwHeight);
+	hr = ReadDword(reader, &header->dwCaps2);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwWidth);
+	hr = ReadDword(reader, &header->dwCaps3);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwPitchOrLinearSize);
+	hr = ReadDword(reader, &header->dwCaps4);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwDepth);
+	hr = ReadDword(reader, &header->dwReserved2);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwMipMapCount);
+	return S_OK;
+}
+
+
+static HRESULT ReadDdsHeaderDxt10(PSTREAM_READER reader, DDS_HEADER_DXT10* header) {
+	HRESULT hr;
+
+	hr = ReadDword(reader, &header->dxgiFormat);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	for (int i = 0; i < 11; i++) {
-		hr = ReadDword(stream, &header->dwReserved1[i]);
-		if (FAILED(hr)) {
-			return hr;
-		}
+	hr = ReadDword(reader, &header->resourceDimension);
+	if (FAILED(hr)) {
+		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwSize);
+	hr = ReadDword(reader, &header->miscFlag);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	if (header->ddspf.dwSize != 0x20) {
-		return E_NOTIMPL;
+	hr = ReadDword(reader, &header->arraySize);
+	if (FAILED(hr)) {
+		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwFlags);
+	hr = ReadDword(reader, &header->miscFlags2);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwFourCC);
+	return S_OK;
+}
+
+
+// DXT_FORMAT code of a plain 2D texture, 0 for anything without a decoder.
+// sRGB and typeless variants decode like UNORM, a thumbnail shows the stored
+// values as they are.
+static DWORD GetDxgiFormat(DDS_HEADER_DXT10* header) {
+	if (header->resourceDimension != DDS_DIMENSION_TEXTURE2D || header->arraySize != 1 || (header->miscFlag & DDS_MISC_TEXTURECUBE)) {
+		return 0;
+	}
+
+	switch (header->dxgiFormat) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB: {
+			return DXT_FORMAT_DXT1;
+		}
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB: {
+			return DXT_FORMAT_DXT3;
+		}
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB: {
+			return DXT_FORMAT_DXT5;
+		}
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM: {
+			return DXT_FORMAT_BC4;
+		}
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM: {
+			return DXT_FORMAT_BC5;
+		}
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB: {
+			return DXT_FORMAT_BC7;
+		}
+	}
+
+	return 0;
+}
+
+
+// PIXEL_FORMAT code of an uncompressed pixel format, matched on its bit
+// count and channel masks. 0 for layouts without an unpack kernel.
+static DWORD GetMaskFormat(DDS_PIXELFORMAT* pf) {
+	BOOL alpha = (pf->dwFlags & DDPF_ALPHAPIXELS) != 0;
+
+	if (pf->dwFlags & DDPF_LUMINANCE) {
+		if (pf->dwRGBBitCount == 8 && pf->dwRBitMask == 0xFF) {
+			return PIXEL_FORMAT_L8;
+		}
+
+		if (pf->dwRGBBitCount == 16 && pf->dwRBitMask == 0xFF && alpha && pf->dwABitMask == 0xFF00) {
+			return PIXEL_FORMAT_A8L8;
+		}
+
+		return 0;
+	}
+
+	if (!(pf->dwFlags & DDPF_RGB)) {
+		return 0;
+	}
+
+	switch (pf->dwRGBBitCount) {
+		case 32: {
+			if (pf->dwRBitMask == 0x00FF0000 && pf->dwGBitMask == 0x0000FF00 && pf->dwBBitMask == 0x000000FF) {
+				return alpha && pf->dwABitMask == 0xFF000000 ? PIXEL_FORMAT_A8R8G8B8 : PIXEL_FORMAT_X8R8G8B8;
+			}
+
+			if (pf->dwRBitMask == 0x000000FF && pf->dwGBitMask == 0x0000FF00 && pf->dwBBitMask == 0x00FF0000) {
+				return alpha && pf->dwABitMask == 0xFF000000 ? PIXEL_FORMAT_A8B8G8R8 : PIXEL_FORMAT_X8B8G8R8;
+			}
+			break;
+		}
+		case 24: {
+			if (pf->dwRBitMask == 0xFF0000 && pf->dwGBitMask == 0x00FF00 && pf->dwBBitMask == 0x0000FF) {
+				return PIXEL_FORMAT_R8G8B8;
+			}
+			break;
+		}
+		case 16: {
+			if (pf->dwRBitMask == 0xF800 && pf->dwGBitMask == 0x07E0 && pf->dwBBitMask == 0x001F) {
+				return PIXEL_FORMAT_R5G6B5;
+			}
+
+			if (pf->dwRBitMask == 0x7C00 && pf->dwGBitMask == 0x03E0 && pf->dwBBitMask == 0x001F) {
+				return alpha && pf->dwABitMask == 0x8000 ? PIXEL_FORMAT_A1R5G5B5 : PIXEL_FORMAT_X1R5G5B5;
+			}
+
+			if (pf->dwRBitMask == 0x0F00 && pf->dwGBitMask == 0x00F0 && pf->dwBBitMask == 0x000F && alpha && pf->dwABitMask == 0xF000) {
+				return PIXEL_FORMAT_A4R4G4B4;
+			}
+			break;
+		}
+	}
+
+	return 0;
+}
+
+
+// Payload bytes of one surface, blocks are 4x4 pixels. Uncompressed rows
+// are not padded.
+static UINT64 GetSurfaceSize(DWORD format, INT32 width, INT32 height) {
+	INT32 blockSize = GetDXTBlockSize(format);
+
+	if (blockSize) {
+		return (UINT64)(((INT64)width + 3) / 4) * (UINT64)(((INT64)height + 3) / 4) * blockSize;
+	}
+
+	return (UINT64)width * (UINT64)height * GetPixelFormatSize(format);
+}
+
+
+HRESULT ReadSpriteFileHeaderV3(PSTREAM_READER reader, SPRITE_FILE_HEADER_V3* header) {
+	HRESULT hr;
+
+	hr = ReadInt32(reader, &header->ID);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwRGBBitCount);
+	if (header->ID != 0x50534449) {
+		return E_UNEXPECTED;
+	}
+
+	hr = ReadInt32(reader, &header->Version);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwRBitMask);
+	if (header->Version != 3) {
+		return E_UNEXPECTED;
+	}
+
+	hr = ReadInt32(reader, &header->Type);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwGBitMask);
+	hr = ReadInt32(reader, &header->TexFormat);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwBBitMask);
+	hr = ReadFloat(reader, &header->BoundingRadius);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->ddspf.dwABitMask);
+	hr = ReadInt32(reader, &header->Width);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwCaps);
+	if (header->Width < 1) {
+		return E_UNEXPECTED;
+	}
+
+	hr = ReadInt32(reader, &header->Height);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwCaps2);
+	if (header->Height < 1) {
+		return E_UNEXPECTED;
+	}
+
+	hr = ReadInt32(reader, &header->FrameCount);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwCaps3);
+	if (header->FrameCount < 1) {
+		return E_UNEXPECTED;
+	}
+
+	hr = ReadFloat(reader, &header->BeamLength);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwCaps4);
+	hr = ReadInt32(reader, &header->SyncType);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	hr = ReadDword(stream, &header->dwReserved2);
+	hr = CheckRemainingBytes(reader, (ULONGLONG)header->FrameCount * SPRITE_MIN_FRAME_SIZE_V3);
 	if (FAILED(hr)) {
 		return hr;
 	}
@@ -223,231 +425,472 @@ static HRESULT ReadDdsHeader(IStream* stream, DDS_HEADER* header) {
 }
 
 
-static HRESULT LoadSpriteFrameV3(IStream* stream, PSPRITE_FRAME_V3* result) {
+HRESULT ReadSpriteFrameHeaderV3(PSTREAM_READER reader, SPRITE_FRAME_HEADER_V3* header, DWORD* dataSize) {
 	HRESULT hr;
 
-	PSPRITE_FRAME_V3 frame = (PSPRITE_FRAME_V3)malloc(sizeof(SPRITE_FRAME_V3));
-
-	if (frame == NULL) {
-		return E_OUTOFMEMORY;
-	}
-
-	memset(frame, 0, sizeof(SPRITE_FRAME_V3));
-
 	DWORD ddsMagic;
 
-	hr = ReadDword(stream, &ddsMagic);
+	hr = ReadDword(reader, &ddsMagic);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
 	// DDS
 	if (ddsMagic != 0x20534444) {
-		free(frame);
 		return E_NOTIMPL;
 	}
 
 	DDS_HEADER ddsHeader;
 
-	hr = ReadDdsHeader(stream, &ddsHeader);
+	hr = ReadDdsHeader(reader, &ddsHeader);
 	if (FAILED(hr)) {
-		free(frame);
 		return hr;
 	}
 
+	DWORD format = ddsHeader.ddspf.dwFourCC;
+
+	if (ddsHeader.ddspf.dwFlags & (DDPF_RGB | DDPF_LUMINANCE)) {
+		format = GetMaskFormat(&ddsHeader.ddspf);
+	}
+
+	switch (format) {
+		case DDS_FOURCC_DX10: {
+			DDS_HEADER_DXT10 dxt10Header;
+
+			hr = ReadDdsHeaderDxt10(reader, &dxt10Header);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			format = GetDxgiFormat(&dxt10Header);
+			break;
+		}
+		case DDS_FOURCC_ATI1: {
+			format = DXT_FORMAT_BC4;
+			break;
+		}
+		case DDS_FOURCC_ATI2: {
+			format = DXT_FORMAT_BC5;
+			break;
+		}
+	}
+
+	// Refused before the payload is touched
+	if (GetDXTBlockSize(format) == 0 && GetPixelFormatSize(format) == 0) {
+		return E_NOTIMPL;
+	}
+
 	if (ddsHeader.dwWidth < 1 || ddsHeader.dwWidth > 0x7FFFFFFF) {
-		free(frame);
 		return E_UNEXPECTED;
 	}
 
 	if (ddsHeader.dwHeight < 1 || ddsHeader.dwHeight > 0x7FFFFFFF) {
-		free(frame);
 		return E_UNEXPECTED;
 	}
 
-	if (ddsHeader.dwMipMapCount != 1) {
-		free(frame);
-		return E_NOTIMPL;
-	}
+	// 0 when the writer did not set DDSD_MIPMAPCOUNT
+	DWORD mipCount = max(1, ddsHeader.dwMipMapCount);
 
-	frame->Header.Width = (INT32)ddsHeader.dwWidth;
-	frame->Header.Height = (INT32)ddsHeader.dwHeight;
-	frame->Header.Format = ddsHeader.ddspf.dwFourCC;
+	// No more levels than it takes to reach 1x1
+	DWORD maxMipCount = 1;
 
-	DWORD dataSize = 0;
+	for (DWORD size = max(ddsHeader.dwWidth, ddsHeader.dwHeight); size > 1; size /= 2) {
+		maxMipCount++;
+	}
 
-	switch (ddsHeader.ddspf.dwFourCC) {
-		// DXT5
-		case 0x35545844: {
-			dataSize = max(1, ((ddsHeader.dwHeight + 3) / 4)) * max(1, ((ddsHeader.dwWidth + 3) / 4)) * 16;
-			break;
-		}
-		default: {
-			free(frame);
-			return E_NOTIMPL;
-		}
+	if (mipCount > maxMipCount) {
+		return E_UNEXPECTED;
 	}
 
-	frame->Pixels = (PBYTE)malloc(dataSize);
+	// The whole chain, summed wide so that huge dimensions cannot wrap
+	// around to a size the input appears to hold
+	UINT64 chainSize = 0;
 
-	if (frame->Pixels == NULL) {
-		free(frame);
-		return E_OUTOFMEMORY;
+	for (DWORD i = 0; i < mipCount; i++) {
+		chainSize += GetSurfaceSize(format, max(1, (INT32)(ddsHeader.dwWidth >> i)), max(1, (INT32)(ddsHeader.dwHeight >> i)));
+	}
+
+	if (chainSize > MAXDWORD) {
+		return E_UNEXPECTED;
 	}
 
-	hr = ReadBytes(stream, frame->Pixels, dataSize);
+	hr = CheckRemainingBytes(reader, chainSize);
 	if (FAILED(hr)) {
-		free(frame->Pixels);
-		free(frame);
 		return hr;
 	}
 
-	*result = frame;
+	header->Width = (INT32)ddsHeader.dwWidth;
+	header->Height = (INT32)ddsHeader.dwHeight;
+	header->Format = format;
+	header->MipCount = (INT32)mipCount;
+
+	*dataSize = (DWORD)chainSize;
 
 	return S_OK;
 }
 
 
-VOID FreeSpriteFileV3(PSPRITE_FILE_V3 sprite) {
-	if (sprite->Frames) {
-		for (INT32 i = 0; i < sprite->Header.FrameCount; i++) {
-			PSPRITE_FRAME_V3 frame = sprite->Frames[i];
-			if (frame) {
-				if (frame->Pixels) {
-					free(frame->Pixels);
-				}
-				free(frame);
-			}
-		}
-		free(sprite->Frames);
+VOID GetSpriteMipLevelV3(SPRITE_FRAME_HEADER_V3* header, INT32 level, INT32* width, INT32* height, DWORD* offset, DWORD* size) {
+	DWORD levelOffset = 0;
+
+	for (INT32 i = 0; i < level; i++) {
+		levelOffset += (DWORD)GetSurfaceSize(header->Format, max(1, header->Width >> i), max(1, header->Height >> i));
+	}
+
+	INT32 levelWidth = max(1, header->Width >> level);
+	INT32 levelHeight = max(1, header->Height >> level);
+
+	if (width) {
+		*width = levelWidth;
+	}
+
+	if (height) {
+		*height = levelHeight;
+	}
+
+	if (offset) {
+		*offset = levelOffset;
+	}
+
+	if (size) {
+		*size = (DWORD)GetSurfaceSize(header->Format, levelWidth, levelHeight);
 	}
-	free(sprite);
 }
 
 
-HRESULT LoadSpriteFileV3(IStream* stream, PSPRITE_FILE_V3* result) {
+INT32 SelectSpriteMipLevelV3(SPRITE_FRAME_HEADER_V3* header, INT32 minWidth, INT32 minHeight) {
+	INT32 level = 0;
+
+	while (level + 1 < header->MipCount &&
+		max(1, header->Width >> (level + 1)) >= minWidth &&
+		max(1, header->Height >> (level + 1)) >= minHeight) {
+		level++;
+	}
+
+	return level;
+}
+
+
+HRESULT SeekSpriteMipLevelV3(PSTREAM_READER reader, PSPRITE_FRAME_V3 frame, INT32 level) {
+	DWORD offset;
+
+	GetSpriteMipLevelV3(&frame->Header, level, &frame->Header.Width, &frame->Header.Height, &offset, NULL);
+
+	frame->Header.MipCount = 1;
+
+	return SkipBytes(reader, offset);
+}
+
+
+static HRESULT SkipSpriteFrameV3(PSTREAM_READER reader) {
 	HRESULT hr;
+	SPRITE_FRAME_HEADER_V3 header;
+	DWORD dataSize;
 
-	PSPRITE_FILE_V3 sprite = (PSPRITE_FILE_V3)malloc(sizeof(SPRITE_FILE_V3));
+	hr = ReadSpriteFrameHeaderV3(reader, &header, &dataSize);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	if (sprite == NULL) {
+	return SkipBytes(reader, dataSize);
+}
+
+
+// Without loadPixels the reader is left at the start of the payload and
+// Pixels stays NULL.
+static HRESULT LoadSpriteFrameV3(PSTREAM_READER reader, PARENA arena, BOOL loadPixels, PSPRITE_FRAME_V3* result) {
+	HRESULT hr;
+
+	PSPRITE_FRAME_V3 frame = (PSPRITE_FRAME_V3)ArenaAlloc(arena, sizeof(SPRITE_FRAME_V3));
+
+	if (frame == NULL) {
 		return E_OUTOFMEMORY;
 	}
 
-	memset(sprite, 0, sizeof(SPRITE_FILE_V3));
+	memset(frame, 0, sizeof(SPRITE_FRAME_V3));
 
-	//
-	// File Header
-	//
+	DWORD dataSize = 0;
 
-	hr = ReadInt32(stream, &sprite->Header.ID);
+	hr = ReadSpriteFrameHeaderV3(reader, &frame->Header, &dataSize);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
 		return hr;
 	}
 
-	if (sprite->Header.ID != 0x50534449) {
-		FreeSpriteFileV3(sprite);
-		return E_UNEXPECTED;
+	if (loadPixels) {
+		frame->Pixels = (PBYTE)ArenaAlloc(arena, dataSize);
+
+		if (frame->Pixels == NULL) {
+			return E_OUTOFMEMORY;
+		}
+
+		hr = ReadBytes(reader, frame->Pixels, dataSize);
+		if (FAILED(hr)) {
+			return hr;
+		}
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Version);
-	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
-		return hr;
+	*result = frame;
+
+	return S_OK;
+}
+
+
+VOID FreeSpriteFileV3(PSPRITE_FILE_V3 sprite) {
+	// Everything, including the sprite itself, lives in the arena
+	FreeArena(sprite->Arena);
+}
+
+
+// Upper bound of the allocations needed for a frame array of slotCount
+// entries and frameCount frames of the size given in the file header, at
+// most 16 bytes per block and no more than the input holds. Anything larger,
+// such as an uncompressed frame or a grown array, makes the arena chain a
+// further block.
+static size_t EstimateArenaSizeV3(SPRITE_FILE_HEADER_V3* header, INT32 slotCount, INT32 frameCount, ULONGLONG available) {
+	const UINT64 maxReserve = 64 * 1024 * 1024;
+	const UINT64 overhead = 16;
+
+	UINT64 blocks = ((UINT64)header->Width + 3) / 4 * (((UINT64)header->Height + 3) / 4);
+
+	UINT64 frameSize = (sizeof(SPRITE_FRAME_V3) + overhead) + overhead;
+
+	UINT64 size = sizeof(SPRITE_FILE_V3) + overhead;
+	size += (UINT64)slotCount * sizeof(PSPRITE_FRAME_V3) + overhead;
+	size += (UINT64)frameCount * frameSize;
+	size += min((UINT64)frameCount * blocks * 16, available);
+
+	return (size_t)min(size, maxReserve);
+}
+
+
+// Grows sprite->Frames to count entries, the new ones are NULL.
+static HRESULT GrowSpriteFramesV3(PSPRITE_FILE_V3 sprite, INT32 count) {
+	size_t frameArraySize = sizeof(PSPRITE_FRAME_V3) * (size_t)count;
+
+	PSPRITE_FRAME_V3* frames = (PSPRITE_FRAME_V3*)ArenaAlloc(sprite->Arena, frameArraySize);
+
+	if (frames == NULL) {
+		return E_OUTOFMEMORY;
 	}
 
-	if (sprite->Header.Version != 3) {
-		FreeSpriteFileV3(sprite);
-		return E_UNEXPECTED;
+	memset(frames, 0, frameArraySize);
+
+	if (sprite->Count > 0) {
+		memcpy(frames, sprite->Frames, sizeof(PSPRITE_FRAME_V3) * (size_t)sprite->Count);
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Type);
-	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
-		return hr;
+	sprite->Frames = frames;
+	sprite->Count = count;
+
+	return S_OK;
+}
+
+
+// Makes room for frame i of a sprite loaded frame by frame, doubling the
+// array so an untrusted frame count is only believed as far as frames turn up.
+static HRESULT ReserveSpriteFrameV3(PSPRITE_FILE_V3 sprite, INT32 i) {
+	if (i < sprite->Count) {
+		return S_OK;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.TexFormat);
+	return GrowSpriteFramesV3(sprite, (INT32)min((INT64)i * 2, (INT64)sprite->Header.FrameCount));
+}
+
+
+// The frame array starts with slotCount entries and the payloads of
+// loadCount frames are reserved for, both clamped to the header's frame
+// count.
+static HRESULT LoadSpriteHeaderV3(PSTREAM_READER reader, INT32 slotCount, INT32 loadCount, PSPRITE_FILE_V3* result) {
+	HRESULT hr;
+
+	SPRITE_FILE_HEADER_V3 header;
+
+	hr = ReadSpriteFileHeaderV3(reader, &header);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
 		return hr;
 	}
 
-	hr = ReadFloat(stream, &sprite->Header.BoundingRadius);
+	//
+	// Storage for everything we are about to load
+	//
+
+	slotCount = min(slotCount, header.FrameCount);
+	loadCount = min(loadCount, header.FrameCount);
+
+	PARENA arena;
+
+	hr = CreateArena(EstimateArenaSizeV3(&header, slotCount, loadCount, GetRemainingBytes(reader)), &arena);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
 		return hr;
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.Width);
+	PSPRITE_FILE_V3 sprite = (PSPRITE_FILE_V3)ArenaAlloc(arena, sizeof(SPRITE_FILE_V3));
+
+	if (sprite == NULL) {
+		FreeArena(arena);
+		return E_OUTOFMEMORY;
+	}
+
+	memset(sprite, 0, sizeof(SPRITE_FILE_V3));
+
+	sprite->Header = header;
+	sprite->Arena = arena;
+
+	//
+	// Frames
+	//
+
+	hr = GrowSpriteFramesV3(sprite, slotCount);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
+		FreeArena(arena);
 		return hr;
 	}
 
-	if (sprite->Header.Width < 1) {
-		FreeSpriteFileV3(sprite);
-		return E_UNEXPECTED;
-	}
+	*result = sprite;
 
-	hr = ReadInt32(stream, &sprite->Header.Height);
+	return S_OK;
+}
+
+
+HRESULT LoadSpriteFileV3(PSTREAM_READER reader, PSPRITE_FILE_V3* result) {
+	HRESULT hr;
+	PSPRITE_FILE_V3 sprite;
+
+	hr = LoadSpriteHeaderV3(reader, SPRITE_FRAMES_INITIAL_CAPACITY_V3, MAXINT32, &sprite);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
 		return hr;
 	}
 
-	if (sprite->Header.Height < 1) {
-		FreeSpriteFileV3(sprite);
-		return E_UNEXPECTED;
+	for (INT32 i = 0; i < sprite->Header.FrameCount; i++) {
+		hr = ReserveSpriteFrameV3(sprite, i);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(sprite);
+			return hr;
+		}
+
+		hr = LoadSpriteFrameV3(reader, sprite->Arena, TRUE, &sprite->Frames[i]);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(sprite);
+			return hr;
+		}
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.FrameCount);
+	*result = sprite;
+
+	return S_OK;
+}
+
+
+static HRESULT LoadSpriteFileV3FrameEx(PSTREAM_READER reader, INT32 frameIndex, BOOL loadPixels, PSPRITE_FILE_V3* result) {
+	HRESULT hr;
+	PSPRITE_FILE_V3 sprite;
+
+	hr = LoadSpriteHeaderV3(reader, 1, loadPixels ? 1 : 0, &sprite);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
 		return hr;
 	}
 
-	if (sprite->Header.FrameCount < 1) {
+	if (frameIndex < 0 || frameIndex >= sprite->Header.FrameCount) {
 		FreeSpriteFileV3(sprite);
-		return E_UNEXPECTED;
+		return E_INVALIDARG;
 	}
 
-	hr = ReadFloat(stream, &sprite->Header.BeamLength);
-	if (FAILED(hr)) {
-		FreeSpriteFileV3(sprite);
-		return hr;
+	if (frameIndex >= sprite->Count) {
+		hr = GrowSpriteFramesV3(sprite, frameIndex + 1);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(sprite);
+			return hr;
+		}
 	}
 
-	hr = ReadInt32(stream, &sprite->Header.SyncType);
+	// Seek over the DDS payloads of the preceding frames.
+	for (INT32 i = 0; i < frameIndex; i++) {
+		hr = SkipSpriteFrameV3(reader);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(sprite);
+			return hr;
+		}
+	}
+
+	hr = LoadSpriteFrameV3(reader, sprite->Arena, loadPixels, &sprite->Frames[frameIndex]);
 	if (FAILED(hr)) {
 		FreeSpriteFileV3(sprite);
 		return hr;
 	}
 
-	//
-	// Frames
-	//
+	*result = sprite;
 
-	size_t frameArraySize = sizeof(PSPRITE_FRAME_V3) * (size_t)sprite->Header.FrameCount;
+	return S_OK;
+}
 
-	sprite->Frames = (PSPRITE_FRAME_V3*)malloc(frameArraySize);
 
-	if (sprite->Frames == NULL) {
-		FreeSpriteFileV3(sprite);
-		return E_OUTOFMEMORY;
+HRESULT LoadSpriteFileV3Frame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE_V3* result) {
+	return LoadSpriteFileV3FrameEx(reader, frameIndex, TRUE, result);
+}
+
+
+HRESULT LocateSpriteFileV3Frame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE_V3* result) {
+	return LoadSpriteFileV3FrameEx(reader, frameIndex, FALSE, result);
+}
+
+
+HRESULT LoadSpriteFileV3Headers(PSTREAM_READER reader, PSPRITE_FILE_V3* result) {
+	HRESULT hr;
+	PSPRITE_FILE_V3 sprite;
+
+	hr = LoadSpriteHeaderV3(reader, SPRITE_FRAMES_INITIAL_CAPACITY_V3, 0, &sprite);
+	if (FAILED(hr)) {
+		return hr;
 	}
 
 	for (INT32 i = 0; i < sprite->Header.FrameCount; i++) {
-		hr = LoadSpriteFrameV3(stream, &sprite->Frames[i]);
+		PSPRITE_FRAME_V3 frame;
+
+		hr = ReserveSpriteFrameV3(sprite, i);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(sprite);
+			return hr;
+		}
+
+		hr = LoadSpriteFrameV3(reader, sprite->Arena, FALSE, &frame);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(sprite);
+			return hr;
+		}
+
+		// The reader was left at the start of the payload
+		hr = SkipBytes(reader, GetSpriteFrameSizeV3(&frame->Header));
 		if (FAILED(hr)) {
 			FreeSpriteFileV3(sprite);
 			return hr;
 		}
+
+		sprite->Frames[i] = frame;
 	}
 
 	*result = sprite;
 
 	return S_OK;
 }
+
+
+DWORD GetSpriteFrameSizeV3(SPRITE_FRAME_HEADER_V3* header) {
+	DWORD size;
+
+	GetSpriteMipLevelV3(header, header->MipCount, NULL, NULL, &size, NULL);
+
+	return size;
+}
+
+
+HRESULT ReadSpriteFramePixelsV3(PSTREAM_READER reader, PSPRITE_FILE_V3 sprite, PSPRITE_FRAME_V3 frame) {
+	DWORD dataSize = GetSpriteFrameSizeV3(&frame->Header);
+
+	frame->Pixels = (PBYTE)ArenaAlloc(sprite->Arena, dataSize);
+
+	if (frame->Pixels == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	return ReadBytes(reader, frame->Pixels, dataSize);
+}
@@ -2,11 +2,15 @@
 
 #include <Windows.h>
 
+#include "StreamReader.h"
+#include "Arena.h"
+
 
 struct SPRITE_FRAME_HEADER_V3 {
 	INT32 Width;
 	INT32 Height;
 	DWORD Format;
+	INT32 MipCount;
 };
 
 
@@ -32,14 +36,60 @@ struct SPRITE_FILE_HEADER_V3 {
 };
 
 
+// Frames has Count entries, Header.FrameCount of them once the whole file is
+// loaded.
 struct SPRITE_FILE_V3 {
 	SPRITE_FILE_HEADER_V3 Header;
+	INT32 Count;
 	PSPRITE_FRAME_V3* Frames;
+	PARENA Arena;
 };
 
 typedef SPRITE_FILE_V3* PSPRITE_FILE_V3;
 
 
+// Validating parsers shared by the loaders and by the mapped views. The
+// frame header parser consumes the DDS header, with its DX10 extension if
+// there is one, and returns the payload size.
+HRESULT ReadSpriteFileHeaderV3(PSTREAM_READER reader, SPRITE_FILE_HEADER_V3* header);
+
+HRESULT ReadSpriteFrameHeaderV3(PSTREAM_READER reader, SPRITE_FRAME_HEADER_V3* header, DWORD* dataSize);
+
+// Size and payload offset of one mip level, levels are stored largest first
+// and halve down to 1x1.
+VOID GetSpriteMipLevelV3(SPRITE_FRAME_HEADER_V3* header, INT32 level, INT32* width, INT32* height, DWORD* offset, DWORD* size);
+
+// Smallest mip level that is still at least minWidth x minHeight, level 0 if
+// none is.
+INT32 SelectSpriteMipLevelV3(SPRITE_FRAME_HEADER_V3* header, INT32 minWidth, INT32 minHeight);
+
+
 VOID FreeSpriteFileV3(PSPRITE_FILE_V3 sprite);
 
-HRESULT LoadSpriteFileV3(IStream* stream, PSPRITE_FILE_V3* result);
+HRESULT LoadSpriteFileV3(PSTREAM_READER reader, PSPRITE_FILE_V3* result);
+
+// Loads the header and a single frame. Frames has frameIndex + 1 entries and
+// only the last one is populated, the payloads of the preceding frames are
+// skipped and nothing after the loaded frame is parsed.
+HRESULT LoadSpriteFileV3Frame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE_V3* result);
+
+// Same as LoadSpriteFileV3Frame without the payload: the loaded frame has
+// Pixels NULL and the reader is left at the start of its mip chain.
+HRESULT LocateSpriteFileV3Frame(PSTREAM_READER reader, INT32 frameIndex, PSPRITE_FILE_V3* result);
+
+// Narrows a frame from LocateSpriteFileV3Frame to one mip level, the reader
+// skips to that level and the header then describes it alone (its size,
+// MipCount 1).
+HRESULT SeekSpriteMipLevelV3(PSTREAM_READER reader, PSPRITE_FRAME_V3 frame, INT32 level);
+
+// Loads the header and every frame header. Pixels stay NULL, the payloads
+// are seeked over without being read.
+HRESULT LoadSpriteFileV3Headers(PSTREAM_READER reader, PSPRITE_FILE_V3* result);
+
+// Payload bytes of all MipCount levels of a frame.
+DWORD GetSpriteFrameSizeV3(SPRITE_FRAME_HEADER_V3* header);
+
+// Reads the payload of a frame from LocateSpriteFileV3Frame into the
+// sprite, the reader must not have moved since other than by
+// SeekSpriteMipLevelV3.
+HRESULT ReadSpriteFramePixelsV3(PSTREAM_READER reader, PSPRITE_FILE_V3 sprite, PSPRITE_FRAME_V3 frame);
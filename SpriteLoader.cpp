@@ -2,32 +2,30 @@
 
 #include "SpriteFile.h"
 #include "SpriteFileV3.h"
+#include "StreamReader.h"
+#include "SpriteView.h"
+#include "PaletteExpand.h"
+#include "SpriteLoader.h"
+#include "DxtDecode.h"
+#include "PixelUnpack.h"
 
-#include "dxt.hpp"
 
-
-static HRESULT ReadDword(IStream* stream, DWORD* result) {
-	HRESULT hr;
-	DWORD buffer;
-	ULONG read;
-
-	hr = stream->Read(&buffer, sizeof(DWORD), &read);
-	if (FAILED(hr)) {
-		return hr;
-	}
-
-	*result = buffer;
-
-	return S_OK;
-}
+// Thumbnail rows a band of streamed indices covers, a few times the resize
+// filter's support so each band's setup in the scaler is shared
+#define SPRITE_INDEX_BAND_ROWS 16
 
 
 static PSPRITE_FRAME_SINGLE SelectFirstFrame(PSPRITE_FILE pSprite)
 {
-	for (INT32 i = 0; i < pSprite->Header.FrameCount; i++)
+	for (INT32 i = 0; i < pSprite->Count; i++)
 	{
 		PSPRITE_FRAME pFrame = pSprite->Frames[i];
 
+		if (pFrame == NULL)
+		{
+			continue;
+		}
+
 		if (pFrame->Type == SPR_SINGLE)
 		{
 			return pFrame->u.Single;
@@ -51,7 +49,7 @@ static PSPRITE_FRAME_SINGLE SelectFirstFrame(PSPRITE_FILE pSprite)
 }
 
 
-static HRESULT ConvertFrameToRGB(PSPRITE_FILE pSprite, PSPRITE_FRAME_SINGLE frame, PBYTE* ppResult)
+static HRESULT ConvertFrame(SPRITE_PALETTE* pPalette, PSPRITE_FRAME_SINGLE frame, PBYTE* ppResult)
 {
 	int nWidth = frame->Header.Width;
 	int nHeight = frame->Header.Height;
@@ -65,198 +63,716 @@ static HRESULT ConvertFrameToRGB(PSPRITE_FILE pSprite, PSPRITE_FRAME_SINGLE fram
 		return E_OUTOFMEMORY;
 	}
 
-	COLOR24* pColors = pSprite->Palette.Colors;
+	UINT32 lut[256];
 
-	BYTE* pSrc = frame->Pixels;
-	BYTE* pDst = pBuffer;
+	BuildPaletteLUT(pPalette, PALETTE_LUT_RGBX, lut);
 
-	int nCount = nWidth * nHeight;
+	ExpandIndices24(lut, frame->Pixels, pBuffer, (size_t)nWidth * (size_t)nHeight);
 
-	for (int i = 0; i < nCount; i++)
-	{
-		BYTE index = *pSrc;
-		COLOR24* color = &pColors[index];
+	*ppResult = pBuffer;
+
+	return S_OK;
+}
+
+
+static HRESULT ConvertDXT(DWORD dwFourCC, INT32 nWidth, INT32 nHeight, PVOID pInput, INT32 nFormat, INT32 nScale, PVOID* pOutput) {
+	INT32 nOutputWidth = (nWidth + nScale - 1) / nScale;
+	INT32 nOutputHeight = (nHeight + nScale - 1) / nScale;
+	INT32 nPixelSize = nFormat == SPRITE_FORMAT_BGRA32 ? 4 : 3;
 
-		*(pDst + 0) = color->R;
-		*(pDst + 1) = color->G;
-		*(pDst + 2) = color->B;
+	size_t nStride = (size_t)nOutputWidth * nPixelSize;
 
-		pSrc += 1;
-		pDst += 3;
+	PBYTE pOutputBuffer = (PBYTE)malloc(nStride * (size_t)nOutputHeight);
+
+	if (pOutputBuffer == NULL) {
+		return E_OUTOFMEMORY;
 	}
 
-	*ppResult = pBuffer;
+	// The decoders clip edge blocks, so no block aligned buffer is needed
+	if (nScale > 1) {
+		PBYTE pStrip = (PBYTE)malloc(GetDXTStripSize(nWidth));
+
+		HRESULT hr = pStrip != NULL
+			? DecodeDXTReduced((PBYTE)pInput, dwFourCC, nWidth, nHeight, nScale, pOutputBuffer, nStride, pStrip)
+			: E_OUTOFMEMORY;
+
+		free(pStrip);
+
+		if (FAILED(hr)) {
+			free(pOutputBuffer);
+			return hr;
+		}
+	}
+	else if (nFormat == SPRITE_FORMAT_BGRA32) {
+		DecodeDXT((PBYTE)pInput, dwFourCC, nWidth, nHeight, pOutputBuffer, nStride);
+	}
+	else {
+		DecodeDXTRGB((PBYTE)pInput, dwFourCC, nWidth, nHeight, pOutputBuffer, nStride);
+	}
+
+	*pOutput = pOutputBuffer;
 
 	return S_OK;
 }
 
 
-static HRESULT LoadSpriteV2(IStream* pStream, INT32* pWidth, INT32* pHeight, PVOID* ppRgb) {
-	HRESULT hr;
+// Uncompressed frames, A8R8G8B8 already is the BGRA layout and is copied
+// without any conversion.
+static HRESULT ConvertPixels(DWORD dwPixelFormat, INT32 nWidth, INT32 nHeight, PVOID pInput, INT32 nFormat, PVOID* pOutput) {
+	size_t nCount = (size_t)nWidth * (size_t)nHeight;
+
+	PBYTE pOutputBuffer = (PBYTE)malloc(nCount * (nFormat == SPRITE_FORMAT_BGRA32 ? 4 : 3));
+
+	if (pOutputBuffer == NULL) {
+		return E_OUTOFMEMORY;
+	}
 
-	// Load SPR file
+	if (nFormat == SPRITE_FORMAT_BGRA32) {
+		UnpackPixels((PBYTE)pInput, dwPixelFormat, pOutputBuffer, nCount);
+	}
+	else {
+		UnpackPixelsRGB((PBYTE)pInput, dwPixelFormat, pOutputBuffer, nCount);
+	}
+
+	*pOutput = pOutputBuffer;
+
+	return S_OK;
+}
+
+
+VOID GetThumbnailSize(INT32 nWidth, INT32 nHeight, INT32 nSize, INT32* pWidth, INT32* pHeight) {
+	*pWidth = nSize;
+	*pHeight = nSize;
+
+	// Exact when the longer side divides evenly, so a frame the loader already
+	// shrank keeps its proportions
+	if (nWidth >= nHeight) {
+		*pHeight = max(1, (INT32)((INT64)nSize * nHeight / nWidth));
+	}
+	else {
+		*pWidth = max(1, (INT32)((INT64)nSize * nWidth / nHeight));
+	}
+}
+
+
+// Largest block reduction that still leaves at least the thumbnail's columns
+// and rows, so ScaleImage keeps shrinking rather than enlarging.
+static INT32 SelectDXTScale(INT32 nWidth, INT32 nHeight, INT32 nTargetWidth) {
+	if (nTargetWidth <= 0) {
+		return 1;
+	}
+
+	INT32 nThumbWidth;
+	INT32 nThumbHeight;
+
+	GetThumbnailSize(nWidth, nHeight, nTargetWidth, &nThumbWidth, &nThumbHeight);
 
-	PSPRITE_FILE pSprite;
+	for (INT32 nScale = 4; nScale > 1; nScale /= 2) {
+		if (nWidth / nScale >= nThumbWidth && nHeight / nScale >= nThumbHeight) {
+			return nScale;
+		}
+	}
 
-	hr = LoadSpriteFile(pStream, &pSprite);
+	return 1;
+}
+
+
+// Reduction DecodeDXTReduced applies to a block compressed frame, 1 for
+// anything else
+static INT32 SelectFrameScaleV3(PSPRITE_FRAME_V3 pFrame, INT32 nTargetWidth) {
+	if (GetDXTBlockSize(pFrame->Header.Format) == 0) {
+		return 1;
+	}
+
+	return SelectDXTScale(pFrame->Header.Width, pFrame->Header.Height, nTargetWidth);
+}
+
+
+// Locates the first frame. For a thumbnail a mip chain is narrowed to its
+// smallest level that still covers the thumbnail both ways, nTargetWidth 0
+// keeps the whole chain.
+static HRESULT LocateThumbnailFrameV3(PSTREAM_READER pReader, INT32 nTargetWidth, PSPRITE_FILE_V3* ppSprite) {
+	HRESULT hr;
+	PSPRITE_FILE_V3 pSprite;
+
+	hr = LocateSpriteFileV3Frame(pReader, 0, &pSprite);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	// Get first frame
+	PSPRITE_FRAME_V3 pFrame = pSprite->Frames[0];
+
+	if (nTargetWidth > 0 && pFrame->Header.MipCount > 1) {
+		INT32 nThumbWidth;
+		INT32 nThumbHeight;
+
+		GetThumbnailSize(pFrame->Header.Width, pFrame->Header.Height, nTargetWidth, &nThumbWidth, &nThumbHeight);
+
+		INT32 nLevel = SelectSpriteMipLevelV3(&pFrame->Header, nThumbWidth, nThumbHeight);
+
+		hr = SeekSpriteMipLevelV3(pReader, pFrame, nLevel);
+		if (FAILED(hr)) {
+			FreeSpriteFileV3(pSprite);
+			return hr;
+		}
+	}
+
+	*ppSprite = pSprite;
 
-	PSPRITE_FRAME_SINGLE pFrame = SelectFirstFrame(pSprite);
-	if (pFrame == NULL) {
-		FreeSpriteFile(pSprite);
-		return E_UNEXPECTED;
+	return S_OK;
+}
+
+
+static HRESULT ConvertFrameV3(PSPRITE_FRAME_V3 pFrame, INT32 nFormat, INT32 nScale, PVOID* ppRgb) {
+	switch (pFrame->Header.Format) {
+		case DXT_FORMAT_DXT1:
+		case DXT_FORMAT_DXT3:
+		case DXT_FORMAT_DXT5:
+		case DXT_FORMAT_BC4:
+		case DXT_FORMAT_BC5:
+		case DXT_FORMAT_BC7: {
+			return ConvertDXT(pFrame->Header.Format, pFrame->Header.Width, pFrame->Header.Height, pFrame->Pixels, nFormat, nScale, ppRgb);
+		}
+	}
+
+	if (GetPixelFormatSize(pFrame->Header.Format) == 0) {
+		return E_NOTIMPL;
 	}
 
-	// Convert to RGB
+	return ConvertPixels(pFrame->Header.Format, pFrame->Header.Width, pFrame->Header.Height, pFrame->Pixels, nFormat, ppRgb);
+}
+
 
-	BYTE* pRgb;
+// Rewinds the stream and reads the format version, leaving the reader at the
+// start of the file.
+static HRESULT OpenSprite(IStream* pStream, PSTREAM_READER pReader, DWORD* pVersion) {
+	HRESULT hr;
+
+	LARGE_INTEGER pos;
+	memset(&pos, 0, sizeof(LARGE_INTEGER));
+
+	pStream->Seek(pos, STREAM_SEEK_SET, NULL);
+
+	InitStreamReader(pReader, pStream);
 
-	hr = ConvertFrameToRGB(pSprite, pFrame, &pRgb);
+	DWORD magic;
 
+	hr = ReadDword(pReader, &magic);
 	if (FAILED(hr)) {
-		FreeSpriteFile(pSprite);
 		return hr;
 	}
 
-	*pWidth = pFrame->Header.Width;
-	*pHeight = pFrame->Header.Height;
-	*ppRgb = pRgb;
+	// IDSP
+	if (magic != 0x50534449) {
+		return E_NOTIMPL;
+	}
 
-	FreeSpriteFile(pSprite);
+	hr = ReadDword(pReader, pVersion);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	return S_OK;
+	// Back to the start, this stays inside the buffered chunk
+	return SkipBytes(pReader, -(LONGLONG)(sizeof(DWORD) * 2));
 }
 
 
-static HRESULT ConvertDXT5(INT32 nWidth, INT32 nHeight, PVOID pInput, PVOID* pOutput) {
-	INT32 nBufferWidth = max(1, ((nWidth + 3) / 4)) * 4;
-	INT32 nBufferHeight = max(1, ((nHeight + 3) / 4)) * 4;
+// Frames no larger than the thumbnail either way are smaller than the bitmap
+// itself, they are held whole and not worth the extra reads of streaming.
+static BOOL FrameShrinks(INT32 nWidth, INT32 nHeight, INT32 nTargetWidth) {
+	if (nTargetWidth <= 0) {
+		return FALSE;
+	}
 
-	size_t nBufferSize = (size_t)nBufferWidth * (size_t)nBufferHeight * 3;
+	INT32 nThumbWidth;
+	INT32 nThumbHeight;
 
-	PBYTE pBuffer = (PBYTE)malloc(nBufferSize);
+	GetThumbnailSize(nWidth, nHeight, nTargetWidth, &nThumbWidth, &nThumbHeight);
 
-	if (pBuffer == NULL) {
-		return E_OUTOFMEMORY;
+	return nWidth > nThumbWidth || nHeight > nThumbHeight;
+}
+
+
+// Holding a decoded frame whole is only avoided when it is over the limit
+// and shrinks for the thumbnail.
+static BOOL ShouldStreamFrame(INT32 nWidth, INT32 nHeight, UINT64 nBytes, INT32 nTargetWidth, size_t nMaxBytes) {
+	return nBytes > nMaxBytes && FrameShrinks(nWidth, nHeight, nTargetWidth);
+}
+
+
+// Bytes of a band of indices, the source rows under SPRITE_INDEX_BAND_ROWS
+// thumbnail rows. That always holds a whole box factor.
+static size_t GetIndexBandBytes(INT32 nWidth, INT32 nHeight, INT32 nTargetWidth, size_t nMaxBytes) {
+	INT32 nThumbWidth;
+	INT32 nThumbHeight;
+
+	GetThumbnailSize(nWidth, nHeight, nTargetWidth, &nThumbWidth, &nThumbHeight);
+
+	INT32 nRows = SPRITE_INDEX_BAND_ROWS * ((nHeight + nThumbHeight - 1) / nThumbHeight);
+
+	return min(nMaxBytes, (size_t)nRows * (size_t)nWidth);
+}
+
+
+static VOID FreeSpriteBands(PSPRITE_BANDS pBands) {
+	if (pBands->Rows != pBands->Source) {
+		free(pBands->Rows);
 	}
 
-	DecompressDXT5((uint8_t*)pInput, nWidth, nHeight, (RGB24*)pBuffer);
+	free(pBands->Source);
+	free(pBands->Strip);
+	free(pBands);
+}
 
-	size_t nOutputBufferSize = (size_t)nWidth * (size_t)nHeight * 3;
 
-	PBYTE pOutputBuffer = (PBYTE)malloc(nOutputBufferSize);
+// Sets up bands of at most nMaxBytes over the payload pReader is at, the
+// bands take the reader over. dwFormat is 0 for palette indices, which are
+// used as read, or the DXT_FORMAT or PIXEL_FORMAT code of a v3 frame,
+// decoded to nWidth BGRA pixels per row.
+static HRESULT CreateSpriteBands(PSTREAM_READER pReader, DWORD dwFormat, INT32 nSourceWidth, INT32 nSourceHeight,
+	INT32 nScale, INT32 nWidth, INT32 nHeight, size_t nMaxBytes, PSPRITE_BANDS* ppBands) {
+	INT32 nBlockSize = GetDXTBlockSize(dwFormat);
+	size_t nStripSize = nBlockSize && nScale > 1 ? GetDXTStripSize(nSourceWidth) : 0;
 
-	if (pOutputBuffer == NULL) {
-		free(pBuffer);
+	INT32 nGroupRows = 1;
+	INT32 nTotalGroups = nSourceHeight;
+	UINT64 nGroupSize;
+	UINT64 nDecodedSize;
+
+	if (dwFormat == 0) {
+		nGroupSize = (UINT64)nSourceWidth;
+		nDecodedSize = 0;
+	}
+	else if (nBlockSize) {
+		nGroupRows = 4 / nScale;
+		nTotalGroups = (nSourceHeight + 3) / 4;
+		nGroupSize = (UINT64)((nSourceWidth + 3) / 4) * nBlockSize;
+		nDecodedSize = (UINT64)nGroupRows * nWidth * 4;
+	}
+	else {
+		nGroupSize = (UINT64)nSourceWidth * GetPixelFormatSize(dwFormat);
+		nDecodedSize = (UINT64)nWidth * 4;
+	}
+
+	// Not even a single row fits
+	if (nStripSize >= nMaxBytes) {
 		return E_OUTOFMEMORY;
 	}
 
-	for (INT32 Y = 0; Y < nHeight; Y++) {
-		for (INT32 X = 0; X < nWidth; X++) {
-			PBYTE pSrc = &pBuffer[(Y * nBufferWidth + X) * 3];
-			PBYTE pDst = &pOutputBuffer[(Y * nWidth + X) * 3];
+	UINT64 nGroupCount = (nMaxBytes - nStripSize) / (nGroupSize + nDecodedSize);
 
-			pDst[0] = pSrc[0]; // R
-			pDst[1] = pSrc[1]; // G
-			pDst[2] = pSrc[2]; // B
-		}
+	if (nGroupCount == 0) {
+		return E_OUTOFMEMORY;
 	}
 
-	free(pBuffer);
+	nGroupCount = min(nGroupCount, (UINT64)nTotalGroups);
 
-	*pOutput = pOutputBuffer;
+	PSPRITE_BANDS pBands = (PSPRITE_BANDS)malloc(sizeof(SPRITE_BANDS));
+
+	if (pBands == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	memset(pBands, 0, sizeof(SPRITE_BANDS));
+
+	pBands->Source = (PBYTE)malloc((size_t)(nGroupSize * nGroupCount));
+	pBands->Rows = dwFormat == 0 ? pBands->Source : (PBYTE)malloc((size_t)(nDecodedSize * nGroupCount));
+	pBands->Strip = nStripSize ? (PBYTE)malloc(nStripSize) : NULL;
+
+	if (pBands->Source == NULL || pBands->Rows == NULL || (nStripSize && pBands->Strip == NULL)) {
+		FreeSpriteBands(pBands);
+		return E_OUTOFMEMORY;
+	}
+
+	// Whatever the loader had buffered past the frame header is still good
+	pBands->Reader = *pReader;
+	pBands->Reader.Data = pBands->Reader.Buffer;
+	pBands->Offset = TellReader(pReader);
+	pBands->Format = dwFormat;
+	pBands->SourceWidth = nSourceWidth;
+	pBands->SourceHeight = nSourceHeight;
+	pBands->Scale = nScale;
+	pBands->GroupRows = nGroupRows;
+	pBands->GroupSize = (ULONG)nGroupSize;
+	pBands->GroupCount = (INT32)nGroupCount;
+	pBands->TotalGroups = nTotalGroups;
+	pBands->Width = nWidth;
+	pBands->Height = nHeight;
+	// Any span this long fits the band that starts at the group of its first row
+	pBands->BandRows = (INT32)nGroupCount * nGroupRows - (nGroupRows - 1);
+
+	*ppBands = pBands;
 
 	return S_OK;
 }
 
 
-static HRESULT LoadSpriteV3(IStream* pStream, INT32* pWidth, INT32* pHeight, PVOID* ppRgb) {
+static HRESULT ReadSpriteBand(PSPRITE_BANDS pBands, INT32 nGroup) {
 	HRESULT hr;
 
-	// Load SPR file
+	INT32 nGroups = min(pBands->GroupCount, pBands->TotalGroups - nGroup);
 
-	PSPRITE_FILE_V3 pSprite;
-
-	hr = LoadSpriteFileV3(pStream, &pSprite);
+	hr = SeekReader(&pBands->Reader, pBands->Offset + (ULONGLONG)nGroup * pBands->GroupSize);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	// Get first frame
-	PSPRITE_FRAME_V3 pFrame = pSprite->Frames[0];
+	hr = ReadBytes(&pBands->Reader, pBands->Source, (ULONG)nGroups * pBands->GroupSize);
+	if (FAILED(hr)) {
+		return hr;
+	}
 
-	// Convert to RGB
+	size_t nStride = (size_t)pBands->Width * 4;
 
-	PVOID pRgb = NULL;
+	if (GetDXTBlockSize(pBands->Format)) {
+		INT32 nSourceRows = min(nGroups * 4, pBands->SourceHeight - nGroup * 4);
 
-	switch (pFrame->Header.Format) {
-		// DXT5
-		case 0x35545844: {
-			hr = ConvertDXT5(pFrame->Header.Width, pFrame->Header.Height, pFrame->Pixels, &pRgb);
-			break;
+		if (pBands->Scale > 1) {
+			hr = DecodeDXTReduced(pBands->Source, pBands->Format, pBands->SourceWidth, nSourceRows, pBands->Scale, pBands->Rows, nStride, pBands->Strip);
+			if (FAILED(hr)) {
+				return hr;
+			}
 		}
-		default: {
-			hr = E_NOTIMPL;
-			break;
+		else {
+			DecodeDXT(pBands->Source, pBands->Format, pBands->SourceWidth, nSourceRows, pBands->Rows, nStride);
 		}
 	}
+	else if (pBands->Format != 0) {
+		UnpackPixels(pBands->Source, pBands->Format, pBands->Rows, (size_t)pBands->SourceWidth * nGroups);
+	}
+
+	pBands->First = nGroup * pBands->GroupRows;
+	pBands->Count = min(nGroups * pBands->GroupRows, pBands->Height - pBands->First);
+
+	return S_OK;
+}
+
 
+HRESULT LoadSpriteImage(IStream* pStream, INT32 nTargetWidth, size_t nMaxBytes, PSPRITE_IMAGE pImage) {
+	HRESULT hr;
+
+	memset(pImage, 0, sizeof(SPRITE_IMAGE));
+
+	STREAM_READER reader;
+	DWORD version;
+
+	hr = OpenSprite(pStream, &reader, &version);
 	if (FAILED(hr)) {
-		FreeSpriteFileV3(pSprite);
 		return hr;
 	}
 
-	*pWidth = pFrame->Header.Width;
-	*pHeight = pFrame->Header.Height;
-	*ppRgb = pRgb;
+	switch (version) {
+		case 2: {
+			// Only the frame we are going to display, its indices stay as they are.
+			// Shrinking frames are read a few rows at a time as the scaler gets to them.
 
-	FreeSpriteFileV3(pSprite);
+			PSPRITE_FILE pSprite;
 
-	return S_OK;
+			hr = LocateSpriteFileFrame(&reader, 0, &pSprite);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			PSPRITE_FRAME_SINGLE pFrame = SelectFirstFrame(pSprite);
+			if (pFrame == NULL) {
+				FreeSpriteFile(pSprite);
+				return E_UNEXPECTED;
+			}
+
+			BuildPaletteLUT(&pSprite->Palette, PALETTE_LUT_BGRA, pImage->Palette);
+
+			INT32 nWidth = pFrame->Header.Width;
+			INT32 nHeight = pFrame->Header.Height;
+
+			if (FrameShrinks(nWidth, nHeight, nTargetWidth)) {
+				hr = CreateSpriteBands(&reader, 0, nWidth, nHeight, 1, nWidth, nHeight,
+					GetIndexBandBytes(nWidth, nHeight, nTargetWidth, nMaxBytes), &pImage->Bands);
+				FreeSpriteFile(pSprite);
+			}
+			else {
+				hr = ReadSpriteFramePixels(&reader, pSprite, pFrame);
+
+				if (FAILED(hr)) {
+					FreeSpriteFile(pSprite);
+				}
+				else {
+					pImage->Indices = pFrame->Pixels;
+					pImage->Sprite = pSprite;
+				}
+			}
+
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			pImage->Width = nWidth;
+			pImage->Height = nHeight;
+			pImage->Paletted = TRUE;
+
+			return S_OK;
+		}
+		case 3: {
+			// Only the mip level the thumbnail needs, decoded at a reduced size if possible
+
+			PSPRITE_FILE_V3 pSprite;
+
+			hr = LocateThumbnailFrameV3(&reader, nTargetWidth, &pSprite);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			PSPRITE_FRAME_V3 pFrame = pSprite->Frames[0];
+
+			INT32 nScale = SelectFrameScaleV3(pFrame, nTargetWidth);
+			INT32 nWidth = (pFrame->Header.Width + nScale - 1) / nScale;
+			INT32 nHeight = (pFrame->Header.Height + nScale - 1) / nScale;
+
+			UINT64 nBytes = GetSpriteFrameSizeV3(&pFrame->Header) + (UINT64)nWidth * (UINT64)nHeight * 4;
+
+			if (ShouldStreamFrame(pFrame->Header.Width, pFrame->Header.Height, nBytes, nTargetWidth, nMaxBytes)) {
+				hr = CreateSpriteBands(&reader, pFrame->Header.Format, pFrame->Header.Width, pFrame->Header.Height,
+					nScale, nWidth, nHeight, nMaxBytes, &pImage->Bands);
+			}
+			else {
+				hr = ReadSpriteFramePixelsV3(&reader, pSprite, pFrame);
+
+				if (SUCCEEDED(hr)) {
+					hr = ConvertFrameV3(pFrame, SPRITE_FORMAT_BGRA32, nScale, &pImage->Pixels);
+				}
+			}
+
+			FreeSpriteFileV3(pSprite);
+
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			pImage->Width = nWidth;
+			pImage->Height = nHeight;
+
+			return S_OK;
+		}
+	}
+
+	return E_NOTIMPL;
 }
 
 
-HRESULT LoadSpriteToRGB(IStream* pStream, INT32* pWidth, INT32* pHeight, PVOID* ppRgb) {
+HRESULT ReadSpriteImageRows(PSPRITE_IMAGE pImage, INT32 y, INT32 count, const BYTE** ppRows) {
 	HRESULT hr;
 
-	LARGE_INTEGER pos;
-	memset(&pos, 0, sizeof(LARGE_INTEGER));
+	if (y < 0 || count < 1 || count > pImage->Height - y) {
+		return E_INVALIDARG;
+	}
 
-	pStream->Seek(pos, STREAM_SEEK_SET, NULL);
+	size_t nStride = (size_t)pImage->Width * (pImage->Paletted ? 1 : 4);
+
+	PSPRITE_BANDS pBands = pImage->Bands;
+
+	if (pBands == NULL) {
+		const BYTE* pBase = pImage->Paletted ? pImage->Indices : (const BYTE*)pImage->Pixels;
+
+		*ppRows = pBase + (size_t)y * nStride;
+
+		return S_OK;
+	}
+
+	if (count > pBands->BandRows) {
+		return E_INVALIDARG;
+	}
+
+	if (y < pBands->First || y + count > pBands->First + pBands->Count) {
+		hr = ReadSpriteBand(pBands, y / pBands->GroupRows);
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
+
+	*ppRows = pBands->Rows + (size_t)(y - pBands->First) * nStride;
+
+	return S_OK;
+}
+
+
+INT32 GetSpriteImageBandRows(PSPRITE_IMAGE pImage) {
+	return pImage->Bands != NULL ? pImage->Bands->BandRows : pImage->Height;
+}
+
+
+VOID FreeSpriteImage(PSPRITE_IMAGE pImage) {
+	if (pImage->Sprite != NULL) {
+		FreeSpriteFile(pImage->Sprite);
+	}
+
+	if (pImage->Bands != NULL) {
+		FreeSpriteBands(pImage->Bands);
+	}
+
+	free(pImage->Pixels);
+
+	memset(pImage, 0, sizeof(SPRITE_IMAGE));
+}
 
-	DWORD magic;
 
-	hr = ReadDword(pStream, &magic);
+static HRESULT ProbeSpriteV2(PSTREAM_READER pReader, PSPRITE_PROBE pProbe) {
+	HRESULT hr;
+	PSPRITE_FRAME_INDEX pIndex;
+
+	hr = BuildSpriteFrameIndex(pReader, &pIndex);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	// IDSP
-	if (magic != 0x50534449) {
+	PSPRITE_PROBE_FRAME pFrames = (PSPRITE_PROBE_FRAME)malloc(sizeof(SPRITE_PROBE_FRAME) * (size_t)pIndex->Count);
+
+	if (pFrames == NULL) {
+		FreeSpriteFrameIndex(pIndex);
+		return E_OUTOFMEMORY;
+	}
+
+	for (INT32 i = 0; i < pIndex->Count; i++) {
+		PSPRITE_FRAME_INDEX_ENTRY pEntry = &pIndex->Entries[i];
+
+		pFrames[i].Frame = pEntry->Frame;
+		pFrames[i].GroupIndex = pEntry->GroupIndex;
+		pFrames[i].Width = pEntry->Header.Width;
+		pFrames[i].Height = pEntry->Header.Height;
+		pFrames[i].Format = 0;
+		pFrames[i].MipCount = 1;
+		pFrames[i].DataSize = (DWORD)pEntry->Header.Width * (DWORD)pEntry->Header.Height;
+	}
+
+	pProbe->Header = pIndex->Header;
+	pProbe->Count = pIndex->Count;
+	pProbe->Frames = pFrames;
+
+	FreeSpriteFrameIndex(pIndex);
+
+	return S_OK;
+}
+
+
+static HRESULT ProbeSpriteV3(PSTREAM_READER pReader, PSPRITE_PROBE pProbe) {
+	HRESULT hr;
+	PSPRITE_FILE_V3 pSprite;
+
+	hr = LoadSpriteFileV3Headers(pReader, &pSprite);
+	if (FAILED(hr)) {
 		return hr;
 	}
 
+	PSPRITE_PROBE_FRAME pFrames = (PSPRITE_PROBE_FRAME)malloc(sizeof(SPRITE_PROBE_FRAME) * (size_t)pSprite->Header.FrameCount);
+
+	if (pFrames == NULL) {
+		FreeSpriteFileV3(pSprite);
+		return E_OUTOFMEMORY;
+	}
+
+	for (INT32 i = 0; i < pSprite->Header.FrameCount; i++) {
+		SPRITE_FRAME_HEADER_V3* pHeader = &pSprite->Frames[i]->Header;
+
+		pFrames[i].Frame = i;
+		pFrames[i].GroupIndex = 0;
+		pFrames[i].Width = pHeader->Width;
+		pFrames[i].Height = pHeader->Height;
+		pFrames[i].Format = pHeader->Format;
+		pFrames[i].MipCount = pHeader->MipCount;
+		pFrames[i].DataSize = GetSpriteFrameSizeV3(pHeader);
+	}
+
+	SPRITE_FILE_HEADER_V3* pHeader = &pSprite->Header;
+
+	pProbe->Header.ID = pHeader->ID;
+	pProbe->Header.Version = pHeader->Version;
+	pProbe->Header.Type = pHeader->Type;
+	pProbe->Header.TexFormat = pHeader->TexFormat;
+	pProbe->Header.BoundingRadius = pHeader->BoundingRadius;
+	pProbe->Header.Width = pHeader->Width;
+	pProbe->Header.Height = pHeader->Height;
+	pProbe->Header.FrameCount = pHeader->FrameCount;
+	pProbe->Header.BeamLength = pHeader->BeamLength;
+	pProbe->Header.SyncType = pHeader->SyncType;
+	pProbe->Count = pHeader->FrameCount;
+	pProbe->Frames = pFrames;
+
+	FreeSpriteFileV3(pSprite);
+
+	return S_OK;
+}
+
+
+HRESULT ProbeSprite(IStream* pStream, PSPRITE_PROBE pProbe) {
+	HRESULT hr;
+
+	STREAM_READER reader;
 	DWORD version;
 
-	hr = ReadDword(pStream, &version);
+	memset(pProbe, 0, sizeof(SPRITE_PROBE));
+
+	hr = OpenSprite(pStream, &reader, &version);
 	if (FAILED(hr)) {
 		return hr;
 	}
 
-	pStream->Seek(pos, STREAM_SEEK_SET, NULL);
-
 	switch (version) {
 		case 2: {
-			return LoadSpriteV2(pStream, pWidth, pHeight, ppRgb);
+			return ProbeSpriteV2(&reader, pProbe);
 		}
 		case 3: {
-			return LoadSpriteV3(pStream, pWidth, pHeight, ppRgb);
+			return ProbeSpriteV3(&reader, pProbe);
 		}
 	}
 
 	return E_NOTIMPL;
 }
+
+
+VOID FreeSpriteProbe(PSPRITE_PROBE pProbe) {
+	free(pProbe->Frames);
+
+	memset(pProbe, 0, sizeof(SPRITE_PROBE));
+}
+
+
+HRESULT LoadSpriteViewToRGB(PSPRITE_VIEW pView, INT32 nFrame, INT32* pWidth, INT32* pHeight, PVOID* ppRgb) {
+	HRESULT hr;
+
+	if (nFrame < 0 || nFrame >= pView->FrameCount) {
+		return E_INVALIDARG;
+	}
+
+	PVOID pRgb = NULL;
+
+	switch (pView->Version) {
+		case 2: {
+			PSPRITE_FRAME_SINGLE pFrame = &pView->Frames[nFrame];
+
+			hr = ConvertFrame(&pView->Palette, pFrame, (PBYTE*)&pRgb);
+
+			*pWidth = pFrame->Header.Width;
+			*pHeight = pFrame->Header.Height;
+			break;
+		}
+		case 3: {
+			PSPRITE_FRAME_V3 pFrame = &pView->FramesV3[nFrame];
+
+			hr = ConvertFrameV3(pFrame, SPRITE_FORMAT_RGB24, 1, &pRgb);
+
+			*pWidth = pFrame->Header.Width;
+			*pHeight = pFrame->Header.Height;
+			break;
+		}
+		default: {
+			hr = E_NOTIMPL;
+			break;
+		}
+	}
+
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	*ppRgb = pRgb;
+
+	return S_OK;
+}
@@ -2,4 +2,115 @@
 
 #include <Windows.h>
 
-HRESULT LoadSpriteToRGB(IStream* pStream, INT32* pWidth, INT32* pHeight, PVOID* ppRgb);
+#include "SpriteFile.h"
+#include "SpriteView.h"
+#include "StreamReader.h"
+
+enum {
+	SPRITE_FORMAT_RGB24 = 0,
+	SPRITE_FORMAT_BGRA32
+};
+
+// Part of a frame too large to hold whole, read from the stream a band of
+// rows at a time. A band is GroupCount groups, a group being one row of
+// indices or pixels or one row of 4x4 blocks. Decoded groups are GroupRows
+// rows of Width BGRA pixels, indices are used as read. Reader carries on
+// from the loader's reader, Offset is the payload's position in it. Strip is
+// the scratch row of blocks of reduced DXT decodes.
+struct SPRITE_BANDS {
+	STREAM_READER Reader;
+	ULONGLONG Offset;
+	DWORD Format;
+	INT32 SourceWidth;
+	INT32 SourceHeight;
+	INT32 Scale;
+	INT32 GroupRows;
+	ULONG GroupSize;
+	INT32 GroupCount;
+	INT32 TotalGroups;
+	INT32 Width;
+	INT32 Height;
+	INT32 BandRows;
+	PBYTE Source;
+	PBYTE Rows;
+	PBYTE Strip;
+	INT32 First;
+	INT32 Count;
+};
+
+typedef SPRITE_BANDS* PSPRITE_BANDS;
+
+// First frame of a sprite for the thumbnail. Paletted frames keep their
+// 8-bit indices with the palette as BGRA entries, so they can be expanded
+// row by row while scaling. Other frames are 32-bit B, G, R, A pixels, the
+// layout a DIB section uses. The rows are held whole in Indices or Pixels,
+// or for large frames are read on demand through Bands.
+struct SPRITE_IMAGE {
+	INT32 Width;
+	INT32 Height;
+	BOOL Paletted;
+	PBYTE Indices;
+	UINT32 Palette[256];
+	PVOID Pixels;
+	PSPRITE_FILE Sprite;
+	PSPRITE_BANDS Bands;
+};
+
+typedef SPRITE_IMAGE* PSPRITE_IMAGE;
+
+// Size of one single frame, group members included. Format is 0 for the
+// 8-bit indices of v2 frames, otherwise the DDS format of the payload.
+// DataSize is the payload in the file, the whole mip chain for v3.
+struct SPRITE_PROBE_FRAME {
+	INT32 Frame;
+	INT32 GroupIndex;
+	INT32 Width;
+	INT32 Height;
+	DWORD Format;
+	INT32 MipCount;
+	DWORD DataSize;
+};
+
+typedef SPRITE_PROBE_FRAME* PSPRITE_PROBE_FRAME;
+
+// Metadata of a sprite of either version, v3 headers are stored in the v2
+// layout they share.
+struct SPRITE_PROBE {
+	SPRITE_FILE_HEADER Header;
+	INT32 Count;
+	PSPRITE_PROBE_FRAME Frames;
+};
+
+typedef SPRITE_PROBE* PSPRITE_PROBE;
+
+// Size of the thumbnail of a nWidth x nHeight frame, fit into an nSize square
+// keeping the aspect ratio. The longer side gets nSize, the other at least 1.
+VOID GetThumbnailSize(INT32 nWidth, INT32 nHeight, INT32 nSize, INT32* pWidth, INT32* pHeight);
+
+// Loads the first frame for a thumbnail that fits an nTargetWidth square.
+// Block compressed frames may be decoded at 1/2 or 1/4 size as long as the
+// result still covers the GetThumbnailSize thumbnail. Paletted frames that
+// shrink for the thumbnail are always streamed, a band holds the rows under
+// a few thumbnail rows. Other frames are streamed when they would take more
+// than nMaxBytes and shrink. Bands are at most nMaxBytes, E_OUTOFMEMORY if
+// not even one row fits.
+HRESULT LoadSpriteImage(IStream* pStream, INT32 nTargetWidth, size_t nMaxBytes, PSPRITE_IMAGE pImage);
+
+// Points at rows [y, y + count) of the image, rows are Width indices or
+// BGRA pixels. Streamed images read a new band when the rows are not in the
+// current one, so count may be at most GetSpriteImageBandRows and the
+// pointer is only valid until the next call.
+HRESULT ReadSpriteImageRows(PSPRITE_IMAGE pImage, INT32 y, INT32 count, const BYTE** ppRows);
+
+INT32 GetSpriteImageBandRows(PSPRITE_IMAGE pImage);
+
+VOID FreeSpriteImage(PSPRITE_IMAGE pImage);
+
+// Reads the file header and every frame header, seeking over the pixel data
+// without decoding any of it.
+HRESULT ProbeSprite(IStream* pStream, PSPRITE_PROBE pProbe);
+
+VOID FreeSpriteProbe(PSPRITE_PROBE pProbe);
+
+// Converts one frame of a mapped view, pixels are read straight from the view.
+HRESULT LoadSpriteViewToRGB(PSPRITE_VIEW pView, INT32 nFrame, INT32* pWidth, INT32* pHeight, PVOID* ppRgb);
@@ -0,0 +1,273 @@
+#include "SpriteView.h"
+#include "StreamReader.h"
+
+
+// Walks the v2 frame records. With frames == NULL only the single frames
+// are counted, otherwise their headers and pixel pointers are stored.
+static HRESULT ParseFramesV2(PSTREAM_READER reader, INT32 frameCount, PSPRITE_FRAME_SINGLE frames, INT32* singleCount) {
+	HRESULT hr;
+	INT32 count = 0;
+
+	for (INT32 i = 0; i < frameCount; i++) {
+		INT32 type;
+
+		hr = ReadSpriteFrameType(reader, &type);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		INT32 groupCount = 1;
+
+		if (type == SPR_GROUP) {
+			hr = ReadSpriteGroupCount(reader, &groupCount);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			// Intervals
+			hr = SkipBytes(reader, (LONGLONG)sizeof(float) * (LONGLONG)groupCount);
+			if (FAILED(hr)) {
+				return hr;
+			}
+		}
+
+		for (INT32 j = 0; j < groupCount; j++) {
+			SPRITE_FRAME_HEADER header;
+
+			hr = ReadSpriteFrameHeader(reader, &header);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			// The frame header was checked against the bytes left
+			ULONG dataSize = (ULONG)header.Width * (ULONG)header.Height;
+
+			PBYTE pixels;
+
+			hr = MapBytes(reader, dataSize, &pixels);
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			if (frames) {
+				frames[count].Header = header;
+				frames[count].Pixels = pixels;
+			}
+
+			count++;
+		}
+	}
+
+	*singleCount = count;
+
+	return S_OK;
+}
+
+
+static HRESULT ParseViewV2(PSPRITE_VIEW view) {
+	HRESULT hr;
+	STREAM_READER reader;
+
+	InitMemoryReader(&reader, view->Data, view->Size);
+
+	hr = ReadSpriteFileHeader(&reader, &view->Header);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	hr = ReadSpritePaletteCount(&reader, &view->Palette.Count);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	PBYTE colors;
+
+	hr = MapBytes(&reader, (ULONG)(view->Palette.Count * sizeof(COLOR24)), &colors);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	view->Palette.Colors = (PCOLOR24)colors;
+
+	ULONG framesStart = reader.Position;
+
+	// Count first, group sizes are only known from the frame records
+	hr = ParseFramesV2(&reader, view->Header.FrameCount, NULL, &view->FrameCount);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	view->Frames = (PSPRITE_FRAME_SINGLE)ArenaAlloc(view->Arena, sizeof(SPRITE_FRAME_SINGLE) * (size_t)view->FrameCount);
+
+	if (view->Frames == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	reader.Position = framesStart;
+
+	return ParseFramesV2(&reader, view->Header.FrameCount, view->Frames, &view->FrameCount);
+}
+
+
+static HRESULT ParseViewV3(PSPRITE_VIEW view) {
+	HRESULT hr;
+	STREAM_READER reader;
+
+	InitMemoryReader(&reader, view->Data, view->Size);
+
+	hr = ReadSpriteFileHeaderV3(&reader, &view->HeaderV3);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	view->FrameCount = view->HeaderV3.FrameCount;
+
+	view->FramesV3 = (PSPRITE_FRAME_V3)ArenaAlloc(view->Arena, sizeof(SPRITE_FRAME_V3) * (size_t)view->FrameCount);
+
+	if (view->FramesV3 == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	for (INT32 i = 0; i < view->FrameCount; i++) {
+		PSPRITE_FRAME_V3 frame = &view->FramesV3[i];
+		DWORD dataSize;
+
+		hr = ReadSpriteFrameHeaderV3(&reader, &frame->Header, &dataSize);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		hr = MapBytes(&reader, dataSize, &frame->Pixels);
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
+
+	return S_OK;
+}
+
+
+HRESULT CreateSpriteView(PVOID data, ULONG size, PSPRITE_VIEW* result) {
+	HRESULT hr;
+
+	if (size < sizeof(INT32) * 2) {
+		return E_UNEXPECTED;
+	}
+
+	PARENA arena;
+
+	hr = CreateArena(sizeof(SPRITE_VIEW), &arena);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	PSPRITE_VIEW view = (PSPRITE_VIEW)ArenaAlloc(arena, sizeof(SPRITE_VIEW));
+
+	if (view == NULL) {
+		FreeArena(arena);
+		return E_OUTOFMEMORY;
+	}
+
+	memset(view, 0, sizeof(SPRITE_VIEW));
+
+	view->Data = (PBYTE)data;
+	view->Size = size;
+	view->Arena = arena;
+
+	memcpy(&view->Version, view->Data + sizeof(INT32), sizeof(INT32));
+
+	switch (view->Version) {
+		case 2: {
+			hr = ParseViewV2(view);
+			break;
+		}
+		case 3: {
+			hr = ParseViewV3(view);
+			break;
+		}
+		default: {
+			hr = E_NOTIMPL;
+			break;
+		}
+	}
+
+	if (FAILED(hr)) {
+		FreeArena(arena);
+		return hr;
+	}
+
+	*result = view;
+
+	return S_OK;
+}
+
+
+HRESULT OpenSpriteView(LPCWSTR path, PSPRITE_VIEW* result) {
+	HRESULT hr;
+
+	HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(hFile, &fileSize)) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(hFile);
+		return hr;
+	}
+
+	// Empty files cannot be mapped, sprites never come close to 4 GB
+	if (fileSize.QuadPart < 1 || fileSize.QuadPart > 0xFFFFFFFF) {
+		CloseHandle(hFile);
+		return E_UNEXPECTED;
+	}
+
+	HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (hMapping == NULL) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(hFile);
+		return hr;
+	}
+
+	PVOID pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (pData == NULL) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return hr;
+	}
+
+	PSPRITE_VIEW view;
+
+	hr = CreateSpriteView(pData, (ULONG)fileSize.QuadPart, &view);
+	if (FAILED(hr)) {
+		UnmapViewOfFile(pData);
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return hr;
+	}
+
+	view->File = hFile;
+	view->Mapping = hMapping;
+
+	*result = view;
+
+	return S_OK;
+}
+
+
+VOID CloseSpriteView(PSPRITE_VIEW view) {
+	if (view->Mapping) {
+		UnmapViewOfFile(view->Data);
+		CloseHandle(view->Mapping);
+	}
+	if (view->File) {
+		CloseHandle(view->File);
+	}
+	FreeArena(view->Arena);
+}
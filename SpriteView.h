@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "SpriteFile.h"
+#include "SpriteFileV3.h"
+#include "Arena.h"
+
+
+// Read-only view of a sprite file held in memory, usually a file mapping.
+// The palette and the frame pixels point straight into the data, nothing
+// is copied. Group frames of v2 sprites are flattened into Frames in file
+// order.
+struct SPRITE_VIEW {
+	HANDLE File;
+	HANDLE Mapping;
+	PBYTE Data;
+	ULONG Size;
+	INT32 Version;
+	SPRITE_FILE_HEADER Header;
+	SPRITE_FILE_HEADER_V3 HeaderV3;
+	SPRITE_PALETTE Palette;
+	INT32 FrameCount;
+	PSPRITE_FRAME_SINGLE Frames;
+	PSPRITE_FRAME_V3 FramesV3;
+	PARENA Arena;
+};
+
+typedef SPRITE_VIEW* PSPRITE_VIEW;
+
+
+// Maps the file read-only and validates it with the same record parsers as
+// LoadSpriteFile/LoadSpriteFileV3.
+HRESULT OpenSpriteView(LPCWSTR path, PSPRITE_VIEW* result);
+
+// Same as OpenSpriteView for data the caller keeps alive, e.g. its own mapping.
+HRESULT CreateSpriteView(PVOID data, ULONG size, PSPRITE_VIEW* result);
+
+VOID CloseSpriteView(PSPRITE_VIEW view);
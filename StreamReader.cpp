@@ -0,0 +1,227 @@
+#include "StreamReader.h"
+
+
+VOID InitStreamReader(PSTREAM_READER reader, IStream* stream) {
+	reader->Stream = stream;
+	reader->Data = reader->Buffer;
+	reader->Offset = 0;
+	reader->Size = MAXULONGLONG;
+	reader->Position = 0;
+	reader->Length = 0;
+	reader->ReadCount = 0;
+
+	// Without a size every check passes and reads fail at the actual end
+	STATSTG stat;
+	LARGE_INTEGER zero;
+	ULARGE_INTEGER position;
+
+	zero.QuadPart = 0;
+
+	if (SUCCEEDED(stream->Stat(&stat, STATFLAG_NONAME)) &&
+		SUCCEEDED(stream->Seek(zero, STREAM_SEEK_CUR, &position)) &&
+		position.QuadPart <= stat.cbSize.QuadPart) {
+		reader->Size = stat.cbSize.QuadPart - position.QuadPart;
+	}
+}
+
+
+VOID InitMemoryReader(PSTREAM_READER reader, PVOID data, ULONG size) {
+	reader->Stream = NULL;
+	reader->Data = (PBYTE)data;
+	reader->Offset = 0;
+	reader->Size = size;
+	reader->Position = 0;
+	reader->Length = size;
+	reader->ReadCount = 0;
+}
+
+
+static HRESULT FillBuffer(PSTREAM_READER reader) {
+	HRESULT hr;
+	ULONG read = 0;
+
+	reader->ReadCount++;
+
+	hr = reader->Stream->Read(reader->Buffer, STREAM_READER_BUFFER_SIZE, &read);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	reader->Offset += reader->Length;
+	reader->Position = 0;
+	reader->Length = read;
+
+	return S_OK;
+}
+
+
+HRESULT ReadBytes(PSTREAM_READER reader, PVOID buffer, ULONG count) {
+	HRESULT hr;
+	PBYTE dst = (PBYTE)buffer;
+
+	// Drain what is already buffered
+	ULONG available = reader->Length - reader->Position;
+	ULONG size = min(available, count);
+
+	memcpy(dst, &reader->Data[reader->Position], size);
+
+	reader->Position += size;
+	dst += size;
+	count -= size;
+
+	if (count == 0) {
+		return S_OK;
+	}
+
+	if (reader->Stream == NULL) {
+		return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	// Large payloads go straight into the destination
+	if (count >= STREAM_READER_BUFFER_SIZE) {
+		ULONG read = 0;
+
+		reader->ReadCount++;
+
+		hr = reader->Stream->Read(dst, count, &read);
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		reader->Offset += reader->Length + read;
+		reader->Position = 0;
+		reader->Length = 0;
+
+		if (read < count) {
+			return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+		}
+
+		return S_OK;
+	}
+
+	hr = FillBuffer(reader);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	size = min(reader->Length, count);
+
+	memcpy(dst, reader->Data, size);
+
+	reader->Position = size;
+
+	if (size < count) {
+		return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	return S_OK;
+}
+
+
+HRESULT ReadUInt8(PSTREAM_READER reader, BYTE* result) {
+	return ReadBytes(reader, result, sizeof(BYTE));
+}
+
+
+HRESULT ReadInt16(PSTREAM_READER reader, INT16* result) {
+	return ReadBytes(reader, result, sizeof(INT16));
+}
+
+
+HRESULT ReadInt32(PSTREAM_READER reader, INT32* result) {
+	return ReadBytes(reader, result, sizeof(INT32));
+}
+
+
+HRESULT ReadDword(PSTREAM_READER reader, DWORD* result) {
+	return ReadBytes(reader, result, sizeof(DWORD));
+}
+
+
+HRESULT ReadFloat(PSTREAM_READER reader, float* result) {
+	return ReadBytes(reader, result, sizeof(float));
+}
+
+
+HRESULT SkipBytes(PSTREAM_READER reader, LONGLONG count) {
+	LONGLONG offset = (LONGLONG)TellReader(reader) + count;
+
+	if (offset < 0) {
+		return E_INVALIDARG;
+	}
+
+	return SeekReader(reader, (ULONGLONG)offset);
+}
+
+
+ULONGLONG TellReader(PSTREAM_READER reader) {
+	return reader->Offset + reader->Position;
+}
+
+
+ULONGLONG GetRemainingBytes(PSTREAM_READER reader) {
+	ULONGLONG position = TellReader(reader);
+
+	// Seeking past the end is allowed, reading there is not
+	if (position >= reader->Size) {
+		return 0;
+	}
+
+	return reader->Size - position;
+}
+
+
+HRESULT CheckRemainingBytes(PSTREAM_READER reader, ULONGLONG count) {
+	if (count > GetRemainingBytes(reader)) {
+		return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	return S_OK;
+}
+
+
+HRESULT SeekReader(PSTREAM_READER reader, ULONGLONG offset) {
+	HRESULT hr;
+
+	// Moves inside the buffered chunk, in either direction, need no seek
+	if (offset >= reader->Offset && offset <= reader->Offset + reader->Length) {
+		reader->Position = (ULONG)(offset - reader->Offset);
+		return S_OK;
+	}
+
+	if (reader->Stream == NULL) {
+		return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	// The stream sits at the end of the buffered chunk
+	LARGE_INTEGER move;
+	move.QuadPart = (LONGLONG)(offset - (reader->Offset + reader->Length));
+
+	hr = reader->Stream->Seek(move, STREAM_SEEK_CUR, NULL);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	reader->Offset = offset;
+	reader->Position = 0;
+	reader->Length = 0;
+
+	return S_OK;
+}
+
+
+HRESULT MapBytes(PSTREAM_READER reader, ULONG count, PBYTE* result) {
+	if (reader->Stream != NULL) {
+		return E_NOTIMPL;
+	}
+
+	if (count > reader->Length - reader->Position) {
+		return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	*result = &reader->Data[reader->Position];
+
+	reader->Position += count;
+
+	return S_OK;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Windows.h>
+
+
+#define STREAM_READER_BUFFER_SIZE 4096
+
+
+// Buffers an IStream so that small fields are decoded from memory instead
+// of issuing one IStream::Read per field. A reader can also be placed over
+// a block of memory (Stream is NULL), Data then covers the whole input.
+// Offset is the input position of Data[0], relative to where the reader
+// was started. Size is the input length from that same point, MAXULONGLONG
+// if the stream cannot report it.
+struct STREAM_READER {
+	IStream* Stream;
+	PBYTE Data;
+	ULONGLONG Offset;
+	ULONGLONG Size;
+	ULONG Position;
+	ULONG Length;
+	ULONG ReadCount;
+	BYTE Buffer[STREAM_READER_BUFFER_SIZE];
+};
+
+typedef STREAM_READER* PSTREAM_READER;
+
+
+VOID InitStreamReader(PSTREAM_READER reader, IStream* stream);
+
+VOID InitMemoryReader(PSTREAM_READER reader, PVOID data, ULONG size);
+
+// Fails with ERROR_HANDLE_EOF if the input ends before count bytes.
+HRESULT ReadBytes(PSTREAM_READER reader, PVOID buffer, ULONG count);
+
+HRESULT ReadUInt8(PSTREAM_READER reader, BYTE* result);
+
+HRESULT ReadInt16(PSTREAM_READER reader, INT16* result);
+
+HRESULT ReadInt32(PSTREAM_READER reader, INT32* result);
+
+HRESULT ReadDword(PSTREAM_READER reader, DWORD* result);
+
+HRESULT ReadFloat(PSTREAM_READER reader, float* result);
+
+HRESULT SkipBytes(PSTREAM_READER reader, LONGLONG count);
+
+ULONGLONG TellReader(PSTREAM_READER reader);
+
+// Bytes left in the input after the current position.
+ULONGLONG GetRemainingBytes(PSTREAM_READER reader);
+
+// Fails with ERROR_HANDLE_EOF unless count more bytes follow, so sizes taken
+// from the input can be rejected before anything is allocated for them.
+HRESULT CheckRemainingBytes(PSTREAM_READER reader, ULONGLONG count);
+
+HRESULT SeekReader(PSTREAM_READER reader, ULONGLONG offset);
+
+// Memory readers only: returns a pointer to the next count bytes in place
+// and advances past them.
+HRESULT MapBytes(PSTREAM_READER reader, ULONG count, PBYTE* result);
@@ -0,0 +1,48 @@
+#include <stdio.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../DxtDecode.h"
+
+
+// A large frame, 16384 blocks
+#define BC7_BENCHMARK_SIZE 512
+
+
+struct BC7_BENCHMARK {
+	std::vector<BYTE> Blocks;
+	std::vector<BYTE> Pixels;
+};
+
+
+static VOID RunDecode(PVOID context) {
+	BC7_BENCHMARK* benchmark = (BC7_BENCHMARK*)context;
+
+	DecodeDXT(benchmark->Blocks.data(), DXT_FORMAT_BC7, BC7_BENCHMARK_SIZE, BC7_BENCHMARK_SIZE, benchmark->Pixels.data(), BC7_BENCHMARK_SIZE * 4);
+}
+
+
+// Random blocks of one mode each, the mode is the lowest set bit of the
+// first byte. Encoders mostly pick modes 1, 5 and 6.
+VOID RunBc7Benchmark() {
+	UINT32 seed = 1;
+
+	BC7_BENCHMARK benchmark;
+
+	benchmark.Blocks.resize((BC7_BENCHMARK_SIZE / 4) * (BC7_BENCHMARK_SIZE / 4) * 16);
+	benchmark.Pixels.resize(BC7_BENCHMARK_SIZE * BC7_BENCHMARK_SIZE * 4);
+
+	printf("%-8s %14s  (%dx%d)\n", "mode", "Mpx/s", BC7_BENCHMARK_SIZE, BC7_BENCHMARK_SIZE);
+
+	for (INT32 mode = 0; mode < 8; mode++) {
+		FillRandom(benchmark.Blocks.data(), benchmark.Blocks.size(), &seed);
+
+		for (size_t i = 0; i < benchmark.Blocks.size(); i += 16) {
+			benchmark.Blocks[i] = (BYTE)((benchmark.Blocks[i] & (0xFE << mode)) | (1 << mode));
+		}
+
+		double seconds = TimeBenchmark(RunDecode, &benchmark);
+
+		printf("%-8d %14.1f\n", mode, BC7_BENCHMARK_SIZE * BC7_BENCHMARK_SIZE / seconds / 1e6);
+	}
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Tests.h"
+#include "../Bc7Decode.h"
+
+
+// One block and its 16 B, G, R, A pixels in row order. The blocks use
+// partition 0 with random endpoints, p-bits and indices. The pixels were
+// worked out from the format specification, not with Bc7Decode.cpp.
+struct BC7_TEST_BLOCK {
+	const char* Name;
+	BYTE Block[16];
+	UINT32 Pixels[16];
+};
+
+
+static const BC7_TEST_BLOCK g_bc7TestBlocks[] = {
+	{
+		"mode 0",
+		{ 0xC1, 0x2A, 0xCE, 0x19, 0x8E, 0x66, 0x31, 0x60, 0x15, 0x97, 0x7D, 0xFF, 0x79, 0xDF, 0x3B, 0x47 },
+		{
+			0xFF5C3109, 0xFF5C3109, 0xFF7B39AD, 0xFF4243B6,
+			0xFF527300, 0xFF61100E, 0xFF7B39AD, 0xFF5F3EB2,
+			0xFF527300, 0xFFD598AD, 0xFFCE8CBD, 0xFF6D3BAF,
+			0xFFE3AF8C, 0xFFCE8CBD, 0xFFE7B584, 0xFFE3AF8C
+		}
+	},
+	{
+		"mode 1",
+		{ 0x02, 0x11, 0xC9, 0x18, 0xD6, 0xEF, 0x24, 0xC2, 0x24, 0xEF, 0xA7, 0x66, 0xA4, 0xEA, 0xF7, 0xE1 },
+		{
+			0xFF517114, 0xFF5C881D, 0xFF212CE5, 0xFF2F37D0,
+			0xFF66A027, 0xFF73B931, 0xFF242EE0, 0xFF2B34D5,
+			0xFF7DD13B, 0xFF88E844, 0xFF1A26EF, 0xFF212CE5,
+			0xFF93FF4E, 0xFF517114, 0xFF242EE0, 0xFF2832DA
+		}
+	},
+	{
+		"mode 2",
+		{ 0x04, 0x12, 0x86, 0x64, 0xFC, 0x83, 0x8B, 0x80, 0xFE, 0x03, 0xC9, 0xD5, 0xC7, 0x6E, 0x01, 0x5F },
+		{
+			0xFF4A39FF, 0xFF4A39FF, 0xFF2110E7, 0xFF842994,
+			0xFFC6C600, 0xFF7367AB, 0xFF2110E7, 0xFF4118CC,
+			0xFF4A39FF, 0xFF188452, 0xFF188452, 0xFF4118CC,
+			0xFFFFF7FF, 0xFFFFF7FF, 0xFFB3D1C6, 0xFF188452
+		}
+	},
+	{
+		"mode 3",
+		{ 0x08, 0x34, 0x0F, 0x03, 0x80, 0xDC, 0x9D, 0x25, 0x3D, 0xC5, 0x63, 0xA0, 0x73, 0x31, 0x89, 0x4D },
+		{
+			0xFF9AE49E, 0xFF3DDFB8, 0xFF014981, 0xFF036C98,
+			0xFF9AE49E, 0xFF3DDFB8, 0xFF0590B0, 0xFF036C98,
+			0xFF9AE49E, 0xFF6CE2AB, 0xFF07B3C7, 0xFF014981,
+			0xFF3DDFB8, 0xFF6CE2AB, 0xFF036C98, 0xFF07B3C7
+		}
+	},
+	{
+		"mode 4, rotation 0, isb 0",
+		{ 0x10, 0xF4, 0xD4, 0xDC, 0x41, 0xCF, 0xB8, 0xF4, 0x38, 0x1F, 0x15, 0x2B, 0x7C, 0x09, 0x97, 0x6B },
+		{
+			0xBFA5ADEF, 0xBF39CE00, 0x8482B8A1, 0x6882B8A1,
+			0xBF5CC34E, 0xF75CC34E, 0x3039CE00, 0xA382B8A1,
+			0xDBA5ADEF, 0xDB39CE00, 0x8482B8A1, 0xA35CC34E,
+			0xDB39CE00, 0x3039CE00, 0xBFA5ADEF, 0xA35CC34E
+		}
+	},
+	{
+		"mode 4, rotation 1, isb 1",
+		{ 0xB0, 0x54, 0x2B, 0x37, 0xF4, 0x5B, 0xAD, 0xFF, 0x66, 0x8F, 0xB5, 0x80, 0x1F, 0xFD, 0xE9, 0xDF },
+		{
+			0xB39C5B4D, 0xCF9C6EBB, 0xB39C5B4D, 0xA5555218,
+			0xA5555218, 0xD65573D6, 0xD65573D6, 0xA59C5218,
+			0xC8556AA1, 0xD6BE73D6, 0xD65573D6, 0xC1776586,
+			0xCF556EBB, 0xD69C73D6, 0xD6BE73D6, 0xCF556EBB
+		}
+	},
+	{
+		"mode 4, rotation 2, isb 0",
+		{ 0x50, 0xC7, 0xAB, 0x4A, 0x7B, 0xAE, 0xA8, 0x59, 0x37, 0xC7, 0x14, 0xA9, 0x4F, 0xCF, 0x66, 0x8F },
+		{
+			0x5239B1A5, 0x7077B1BD, 0x707779BD, 0xADF779EF,
+			0x5239B1A5, 0xADF728EF, 0x8FB996D7, 0x8FB9B1D7,
+			0xADF728EF, 0x8FB9CCD7, 0x707796BD, 0x8FB996D7,
+			0xADF743EF, 0x523943A5, 0x8FB996D7, 0x707779BD
+		}
+	},
+	{
+		"mode 4, rotation 3, isb 1",
+		{ 0xF0, 0xDA, 0x79, 0x9A, 0x31, 0xDF, 0x5E, 0xE9, 0x22, 0xAD, 0xBD, 0xF6, 0x6A, 0x0D, 0x88, 0xA1 },
+		{
+			0xCCBAE0DF, 0xC673A5B6, 0xCCBAE0CA, 0xCBACD4CA,
+			0xC673A5F3, 0xC88FBCDF, 0xCCBAE0B6, 0xCBACD4DF,
+			0xC88FBCDF, 0xCDC8EBF3, 0xCED6F7DF, 0xC99DC8CA,
+			0xCED6F7CA, 0xCBACD4DF, 0xCED6F7DF, 0xC88FBCB6
+		}
+	},
+	{
+		"mode 5, rotation 0, isb 0",
+		{ 0x20, 0x64, 0x29, 0x95, 0xBB, 0x5C, 0x8B, 0x0E, 0xBB, 0xE9, 0x00, 0xDE, 0x48, 0x28, 0x13, 0x5F },
+		{
+			0xA2C9A997, 0xB8A5B9D7, 0xA2BDAEAC, 0xADA5B9D7,
+			0xA2C9A997, 0xB8BDAEAC, 0xB8A5B9D7, 0xA2BDAEAC,
+			0xC3C9A997, 0xA2C9A997, 0xADC9A997, 0xA2C9A997,
+			0xC3A5B9D7, 0xC3A5B9D7, 0xADB1B4C2, 0xADBDAEAC
+		}
+	},
+	{
+		"mode 5, rotation 1, isb 0",
+		{ 0x60, 0xAB, 0xF6, 0x98, 0xDA, 0xF3, 0xC3, 0x61, 0x68, 0xC5, 0xC8, 0x5B, 0xC6, 0x56, 0xA0, 0x95 },
+		{
+			0x5653C77A, 0x8253BDA5, 0xDB70A9FD, 0xAF18B3D2,
+			0xAF35B3D2, 0x5653C77A, 0xAF53B3D2, 0x8253BDA5,
+			0x5670C77A, 0x8270BDA5, 0xAF35B3D2, 0xDB35A9FD,
+			0x8253BDA5, 0xDB53A9FD, 0xAF53B3D2, 0x5635C77A
+		}
+	},
+	{
+		"mode 5, rotation 2, isb 0",
+		{ 0xA0, 0xEE, 0x82, 0x48, 0xB4, 0x4F, 0xFC, 0xFD, 0x66, 0x93, 0xD9, 0xDA, 0x3B, 0x19, 0xD0, 0xC9 },
+		{
+			0x449894AC, 0x44DDAAF7, 0x440ABF12, 0x444F7F5D,
+			0x449894AC, 0x444FAA5D, 0x44DD94F7, 0x440A7F12,
+			0x44DD7FF7, 0x440A7F12, 0x444F945D, 0x4498BFAC,
+			0x449894AC, 0x440AAA12, 0x444F7F5D, 0x440ABF12
+		}
+	},
+	{
+		"mode 5, rotation 3, isb 0",
+		{ 0xE0, 0xDB, 0xD9, 0x8D, 0xBD, 0x50, 0x0B, 0x27, 0x20, 0xD8, 0x1E, 0x38, 0xAC, 0xEA, 0x91, 0xFB },
+		{
+			0x16B76EC2, 0x16B76E09, 0x559C9146, 0x16B76E46,
+			0x16B76E46, 0xD566D946, 0x9681B646, 0x559C9109,
+			0xD566D985, 0xD566D9C2, 0x16B76E85, 0x16B76E46,
+			0x16B76E09, 0xD566D946, 0x559C9109, 0x16B76E09
+		}
+	},
+	{
+		"mode 6",
+		{ 0xC0, 0xE2, 0x92, 0x85, 0x7B, 0x06, 0xE2, 0xDE, 0xBC, 0x28, 0x60, 0xB2, 0x91, 0x97, 0x00, 0x45 },
+		{
+			0xD38F625F, 0xC6936A2C, 0xCE91654C, 0xDE8D5C89,
+			0xE38B599F, 0xD38F625F, 0xDE8D5C89, 0xC6936A2C,
+			0xE18C5A95, 0xCC926742, 0xD1906455, 0xCC926742,
+			0xE38B599F, 0xE38B599F, 0xD68F616B, 0xD98E5F75
+		}
+	},
+	{
+		"mode 7",
+		{ 0x80, 0x00, 0xA2, 0xC3, 0x8C, 0xE2, 0x20, 0x8D, 0xA1, 0xB1, 0xB4, 0xD8, 0x40, 0xC2, 0xB0, 0x64 },
+		{
+			0x65451CA6, 0x65451CA6, 0x5E287C49, 0x59187108,
+			0x5D65219E, 0x65451CA6, 0x5E287C49, 0x5C207728,
+			0x65451CA6, 0x55862796, 0x5C207728, 0x5C207728,
+			0x55862796, 0x65451CA6, 0x61308269, 0x59187108
+		}
+	},
+	{
+		"reserved mode 8",
+		{ 0 },
+		{ 0 }
+	}
+};
+
+
+VOID RunBc7Tests() {
+	for (INT32 i = 0; i < ARRAYSIZE(g_bc7TestBlocks); i++) {
+		const BC7_TEST_BLOCK* test = &g_bc7TestBlocks[i];
+
+		UINT32 pixels[16];
+
+		DecodeBC7Block(test->Block, pixels);
+
+		BOOL match = memcmp(pixels, test->Pixels, sizeof(pixels)) == 0;
+
+		if (!match) {
+			printf("DecodeBC7Block %s\n", test->Name);
+
+			for (INT32 j = 0; j < 16; j++) {
+				printf("  %2d: %08X, expected %08X\n", j, pixels[j], test->Pixels[j]);
+			}
+		}
+
+		TEST_CHECK(match);
+	}
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <wchar.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+
+
+// Long enough to average out the timer resolution and turbo ramp-up
+#define BENCHMARK_MIN_SECONDS 0.2
+
+
+struct BENCHMARK {
+	LPCWSTR Name;
+	VOID (*Run)();
+};
+
+
+static const BENCHMARK g_benchmarks[] = {
+	{ L"palette", RunPaletteBenchmark },
+	{ L"dxt", RunDxtBenchmark },
+	{ L"bc7", RunBc7Benchmark },
+	{ L"resize", RunResizeBenchmark },
+	{ L"memory", RunMemoryBenchmark },
+	{ L"loader", RunLoaderBenchmark },
+	{ L"view", RunViewBenchmark },
+	{ L"probe", RunProbeBenchmark }
+};
+
+
+double TimeBenchmark(VOID (*run)(PVOID context), PVOID context) {
+	run(context);
+
+	INT32 calls = 0;
+	double seconds = 0.0;
+
+	LONGLONG start = GetTimestamp();
+
+	do {
+		run(context);
+		calls++;
+		seconds = GetElapsedSeconds(start);
+	} while (seconds < BENCHMARK_MIN_SECONDS);
+
+	return seconds / calls;
+}
+
+
+// SpriteBenchmarks [name], best run from a Release build.
+int wmain(int argc, wchar_t** argv) {
+	LPCWSTR name = argc > 1 ? argv[1] : NULL;
+
+	BOOL found = FALSE;
+
+	for (INT32 i = 0; i < ARRAYSIZE(g_benchmarks); i++) {
+		if (name == NULL || _wcsicmp(name, g_benchmarks[i].Name) == 0) {
+			printf("== %ls\n", g_benchmarks[i].Name);
+			g_benchmarks[i].Run();
+			found = TRUE;
+		}
+	}
+
+	if (!found) {
+		printf("unknown benchmark %ls\n", name);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// Calls run with the context until BENCHMARK_MIN_SECONDS have passed, after
+// one untimed warm-up call. Returns the average seconds per call.
+double TimeBenchmark(VOID (*run)(PVOID context), PVOID context);
+
+
+// Benchmarks, run in this order by wmain or one at a time by name.
+VOID RunPaletteBenchmark();
+VOID RunDxtBenchmark();
+VOID RunBc7Benchmark();
+VOID RunResizeBenchmark();
+VOID RunMemoryBenchmark();
+VOID RunLoaderBenchmark();
+VOID RunViewBenchmark();
+VOID RunProbeBenchmark();
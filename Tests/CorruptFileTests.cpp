@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <wchar.h>
+
+#include "Tests.h"
+#include "TestSupport.h"
+#include "../SpriteLoader.h"
+
+
+// Every file in the corpus must be refused from its headers, long before a
+// loader could have walked a huge frame count or touched a huge payload.
+#define CORRUPT_FILE_TIME_LIMIT 0.25
+
+// Same limits the thumbnail provider uses by default
+#define CORRUPT_FILE_THUMBNAIL_SIZE 256
+#define CORRUPT_FILE_MEMORY_LIMIT   (16 * 1024 * 1024)
+
+
+static VOID CheckCorruptFile(LPCWSTR path, DWORD flags) {
+	PTEST_STREAM stream;
+
+	HRESULT hr = OpenTestStream(path, flags, &stream);
+	TEST_CHECK(SUCCEEDED(hr));
+
+	if (FAILED(hr)) {
+		return;
+	}
+
+	LONGLONG start = GetTimestamp();
+
+	SPRITE_IMAGE image;
+
+	hr = LoadSpriteImage(stream, CORRUPT_FILE_THUMBNAIL_SIZE, CORRUPT_FILE_MEMORY_LIMIT, &image);
+
+	// Without the stream size nothing past the first frame is known to be
+	// missing, and streamed rows are only found missing when they are read
+	if (SUCCEEDED(hr)) {
+		if (!(flags & TEST_STREAM_NO_STAT)) {
+			printf("%ls: LoadSpriteImage succeeded\n", path);
+		}
+
+		ReadTestImageRows(&image);
+		FreeSpriteImage(&image);
+	}
+
+	double seconds = GetElapsedSeconds(start);
+
+	if (!(flags & TEST_STREAM_NO_STAT)) {
+		TEST_CHECK(FAILED(hr));
+	}
+
+	TEST_CHECK(seconds < CORRUPT_FILE_TIME_LIMIT);
+
+	LARGE_INTEGER zero = {};
+
+	stream->Seek(zero, STREAM_SEEK_SET, NULL);
+
+	start = GetTimestamp();
+
+	SPRITE_PROBE probe;
+
+	hr = ProbeSprite(stream, &probe);
+
+	seconds = GetElapsedSeconds(start);
+
+	if (SUCCEEDED(hr)) {
+		FreeSpriteProbe(&probe);
+	}
+
+	// Likewise a payload cut short at the end of the file, probing never
+	// reads it
+	if (!(flags & TEST_STREAM_NO_STAT)) {
+		if (SUCCEEDED(hr)) {
+			printf("%ls: ProbeSprite succeeded\n", path);
+		}
+
+		TEST_CHECK(FAILED(hr));
+	}
+
+	TEST_CHECK(seconds < CORRUPT_FILE_TIME_LIMIT);
+
+	stream->Release();
+}
+
+
+VOID RunCorruptFileTests(LPCWSTR corpusPath) {
+	WCHAR pattern[MAX_PATH];
+
+	swprintf_s(pattern, ARRAYSIZE(pattern), L"%ls\\*.spr", corpusPath);
+
+	WIN32_FIND_DATAW findData;
+
+	HANDLE find = FindFirstFileW(pattern, &findData);
+	TEST_CHECK(find != INVALID_HANDLE_VALUE);
+
+	if (find == INVALID_HANDLE_VALUE) {
+		printf("%ls: no corpus files\n", pattern);
+		return;
+	}
+
+	INT32 count = 0;
+
+	do {
+		WCHAR path[MAX_PATH];
+
+		swprintf_s(path, ARRAYSIZE(path), L"%ls\\%ls", corpusPath, findData.cFileName);
+
+		CheckCorruptFile(path, 0);
+		CheckCorruptFile(path, TEST_STREAM_NO_STAT);
+
+		count++;
+	} while (FindNextFileW(find, &findData));
+
+	FindClose(find);
+
+	printf("corrupt files: %d checked\n", count);
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../DxtDecode.h"
+
+
+// A large frame, 16384 blocks
+#define DXT_BENCHMARK_SIZE 512
+
+
+struct DXT_BENCHMARK {
+	DWORD Format;
+	std::vector<BYTE> Blocks;
+	std::vector<BYTE> Pixels;
+};
+
+
+static VOID RunDecode(PVOID context) {
+	DXT_BENCHMARK* benchmark = (DXT_BENCHMARK*)context;
+
+	DecodeDXT(benchmark->Blocks.data(), benchmark->Format, DXT_BENCHMARK_SIZE, DXT_BENCHMARK_SIZE, benchmark->Pixels.data(), DXT_BENCHMARK_SIZE * 4);
+}
+
+
+// Sizes that are not a multiple of 4, the edge blocks are clipped
+struct DXT_EDGE_BENCHMARK_SIZE {
+	INT32 Width;
+	INT32 Height;
+};
+
+static const DXT_EDGE_BENCHMARK_SIZE g_dxtEdgeBenchmarkSizes[] = {
+	{ 30, 30 },
+	{ 127, 95 },
+	{ 257, 129 },
+	{ 510, 510 },
+	{ 1023, 767 }
+};
+
+
+struct DXT_EDGE_BENCHMARK {
+	INT32 Width;
+	INT32 Height;
+	std::vector<BYTE> Blocks;
+	std::vector<BYTE> Pixels;
+};
+
+
+// 24-bit decode straight into the exact size buffer.
+static VOID RunStridedDecode(PVOID context) {
+	DXT_EDGE_BENCHMARK* benchmark = (DXT_EDGE_BENCHMARK*)context;
+
+	DecodeDXTRGB(benchmark->Blocks.data(), DXT_FORMAT_DXT5, benchmark->Width, benchmark->Height, benchmark->Pixels.data(), benchmark->Width * 3);
+}
+
+
+// What ConvertDXT5 did before: a block aligned buffer, then a crop copy.
+static VOID RunCroppedDecode(PVOID context) {
+	DXT_EDGE_BENCHMARK* benchmark = (DXT_EDGE_BENCHMARK*)context;
+
+	INT32 blockWidth = (benchmark->Width + 3) & ~3;
+	INT32 blockHeight = (benchmark->Height + 3) & ~3;
+
+	PBYTE blocks = (PBYTE)malloc((size_t)blockWidth * blockHeight * 3);
+	if (blocks == NULL) {
+		return;
+	}
+
+	DecodeDXTRGB(benchmark->Blocks.data(), DXT_FORMAT_DXT5, blockWidth, blockHeight, blocks, blockWidth * 3);
+
+	for (INT32 y = 0; y < benchmark->Height; y++) {
+		memcpy(&benchmark->Pixels[(size_t)y * benchmark->Width * 3], blocks + (size_t)y * blockWidth * 3, (size_t)benchmark->Width * 3);
+	}
+
+	free(blocks);
+}
+
+
+struct DXT_FILE_BENCHMARK {
+	PTEST_STREAM Stream;
+	HRESULT Result;
+};
+
+
+// A v3 frame from the stream to BGRA rows at its full size, like the
+// provider does for a thumbnail as large as the frame.
+static VOID RunFileLoad(PVOID context) {
+	DXT_FILE_BENCHMARK* benchmark = (DXT_FILE_BENCHMARK*)context;
+
+	LARGE_INTEGER start = {};
+	benchmark->Stream->Seek(start, STREAM_SEEK_SET, NULL);
+
+	SPRITE_IMAGE image;
+
+	benchmark->Result = LoadSpriteImage(benchmark->Stream, DXT_BENCHMARK_SIZE, MAXINT32, &image);
+
+	if (SUCCEEDED(benchmark->Result)) {
+		benchmark->Result = ReadTestImageRows(&image);
+		FreeSpriteImage(&image);
+	}
+}
+
+
+static VOID RunFileBenchmark(const DWORD* formats, INT32 count) {
+	UINT32 seed = 3;
+
+	printf("%-8s %14s %14s  (v3 file, %dx%d)\n", "format", "files/s", "Mpx/s", DXT_BENCHMARK_SIZE, DXT_BENCHMARK_SIZE);
+
+	for (INT32 i = 0; i < count; i++) {
+		std::vector<BYTE> file;
+		WriteSpriteV3(file, 1, DXT_BENCHMARK_SIZE, DXT_BENCHMARK_SIZE, formats[i], 1, &seed);
+
+		DXT_FILE_BENCHMARK benchmark = {};
+
+		if (FAILED(CreateTestStream(file.data(), (ULONG)file.size(), 0, &benchmark.Stream))) {
+			continue;
+		}
+
+		double seconds = TimeBenchmark(RunFileLoad, &benchmark);
+
+		benchmark.Stream->Release();
+
+		if (FAILED(benchmark.Result)) {
+			printf("%.4s     failed, 0x%08X\n", (const char*)&formats[i], (UINT32)benchmark.Result);
+			continue;
+		}
+
+		printf("%.4s     %14.1f %14.1f\n", (const char*)&formats[i], 1.0 / seconds, DXT_BENCHMARK_SIZE * DXT_BENCHMARK_SIZE / seconds / 1e6);
+	}
+}
+
+
+static VOID RunEdgeBenchmark() {
+	UINT32 seed = 2;
+
+	printf("%-12s %14s %14s %10s  (DXT5 to RGB, Mpx/s)\n", "size", "cropped", "strided", "speedup");
+
+	for (INT32 i = 0; i < ARRAYSIZE(g_dxtEdgeBenchmarkSizes); i++) {
+		DXT_EDGE_BENCHMARK benchmark;
+		benchmark.Width = g_dxtEdgeBenchmarkSizes[i].Width;
+		benchmark.Height = g_dxtEdgeBenchmarkSizes[i].Height;
+		benchmark.Blocks.resize((size_t)((benchmark.Width + 3) / 4) * ((benchmark.Height + 3) / 4) * GetDXTBlockSize(DXT_FORMAT_DXT5));
+		benchmark.Pixels.resize((size_t)benchmark.Width * benchmark.Height * 3);
+
+		FillRandom(benchmark.Blocks.data(), benchmark.Blocks.size(), &seed);
+
+		double cropped = TimeBenchmark(RunCroppedDecode, &benchmark);
+		double strided = TimeBenchmark(RunStridedDecode, &benchmark);
+
+		double pixels = (double)benchmark.Width * benchmark.Height;
+
+		char name[32];
+		sprintf_s(name, sizeof(name), "%dx%d", benchmark.Width, benchmark.Height);
+
+		printf("%-12s %14.1f %14.1f %9.2fx\n", name, pixels / cropped / 1e6, pixels / strided / 1e6, cropped / strided);
+	}
+}
+
+
+VOID RunDxtBenchmark() {
+	static const DWORD formats[] = { DXT_FORMAT_DXT1, DXT_FORMAT_DXT3, DXT_FORMAT_DXT5 };
+
+	UINT32 seed = 1;
+
+	DXT_BENCHMARK benchmarks[ARRAYSIZE(formats)];
+
+	for (INT32 i = 0; i < ARRAYSIZE(formats); i++) {
+		benchmarks[i].Format = formats[i];
+		benchmarks[i].Blocks.resize((DXT_BENCHMARK_SIZE / 4) * (DXT_BENCHMARK_SIZE / 4) * GetDXTBlockSize(formats[i]));
+		benchmarks[i].Pixels.resize(DXT_BENCHMARK_SIZE * DXT_BENCHMARK_SIZE * 4);
+
+		FillRandom(benchmarks[i].Blocks.data(), benchmarks[i].Blocks.size(), &seed);
+	}
+
+	printf("%-8s %14s %14s %14s  (Mpx/s, %dx%d)\n", "level", "DXT1", "DXT3", "DXT5", DXT_BENCHMARK_SIZE, DXT_BENCHMARK_SIZE);
+
+	for (INT32 i = 0; i < g_testCpuLevelCount; i++) {
+		PCTEST_CPU_LEVEL level = &g_testCpuLevels[i];
+
+		if (!SelectTestCpuLevel(level)) {
+			continue;
+		}
+
+		printf("%-8s", level->Name);
+
+		for (INT32 j = 0; j < ARRAYSIZE(formats); j++) {
+			double seconds = TimeBenchmark(RunDecode, &benchmarks[j]);
+
+			printf(" %14.1f", DXT_BENCHMARK_SIZE * DXT_BENCHMARK_SIZE / seconds / 1e6);
+		}
+
+		printf("\n");
+	}
+
+	ResetTestCpuLevel();
+
+	RunFileBenchmark(formats, ARRAYSIZE(formats));
+	RunEdgeBenchmark();
+}
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Tests.h"
+#include "TestSupport.h"
+#include "../DxtDecode.h"
+#include "../dxt.hpp"
+
+
+// Extra bytes at the end of each output row, they must stay untouched
+#define DXT_TEST_ROW_PADDING 12
+
+
+// Block counts per row of 1 to 17 cover the AVX2 pairs, the odd block after
+// them and the clipped column at the edge.
+static const INT32 g_dxtTestWidths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 12, 13, 16, 20, 28, 30, 36, 64, 68 };
+static const INT32 g_dxtTestHeights[] = { 1, 3, 4, 5, 8, 11, 16 };
+
+static const DWORD g_dxtTestFormats[] = { DXT_FORMAT_DXT1, DXT_FORMAT_DXT3, DXT_FORMAT_DXT5 };
+
+// Sizes that cut the edge blocks, checked for every format with a decoder
+static const INT32 g_dxtEdgeTestSizes[] = { 1, 2, 3, 5, 6, 7 };
+
+static const DWORD g_dxtEdgeTestFormats[] = {
+	DXT_FORMAT_DXT1, DXT_FORMAT_DXT3, DXT_FORMAT_DXT5, DXT_FORMAT_BC4, DXT_FORMAT_BC5, DXT_FORMAT_BC7
+};
+
+
+static VOID DecodeReference(const BYTE* input, DWORD format, INT32 width, INT32 height, BYTE* output, size_t stride) {
+	switch (format) {
+		case DXT_FORMAT_DXT1: {
+			DecompressDXT1BGRA((uint8_t*)input, width, height, (uint32_t*)output, stride);
+			break;
+		}
+		case DXT_FORMAT_DXT3: {
+			DecompressDXT3BGRA((uint8_t*)input, width, height, (uint32_t*)output, stride);
+			break;
+		}
+		case DXT_FORMAT_DXT5: {
+			DecompressDXT5BGRA((uint8_t*)input, width, height, (uint32_t*)output, stride);
+			break;
+		}
+	}
+}
+
+
+// Random blocks, every other one with its endpoints ordered so that
+// color0 <= color1 selects the three color mode (equal endpoints included).
+static VOID FillDxtBlocks(BYTE* blocks, DWORD format, INT32 count, UINT32* seed) {
+	INT32 blockSize = GetDXTBlockSize(format);
+	INT32 colorOffset = blockSize - 8;
+
+	FillRandom(blocks, (size_t)count * blockSize, seed);
+
+	for (INT32 i = 0; i < count; i++) {
+		BYTE* color = blocks + (size_t)i * blockSize + colorOffset;
+
+		UINT16 color0 = (UINT16)(color[0] | (color[1] << 8));
+		UINT16 color1 = (UINT16)(color[2] | (color[3] << 8));
+
+		if (i % 4 == 1 && color0 > color1) {
+			memcpy(color, &color1, 2);
+			memcpy(color + 2, &color0, 2);
+		}
+		else if (i % 4 == 3) {
+			memcpy(color + 2, &color0, 2);
+		}
+	}
+}
+
+
+static VOID CheckDecodeDXT(PCTEST_CPU_LEVEL level, DWORD format, INT32 width, INT32 height, UINT32* seed) {
+	INT32 blockCount = ((width + 3) / 4) * ((height + 3) / 4);
+	size_t stride = (size_t)width * 4 + DXT_TEST_ROW_PADDING;
+
+	std::vector<BYTE> blocks((size_t)blockCount * GetDXTBlockSize(format));
+	std::vector<BYTE> expected(stride * height, 0xCD);
+	std::vector<BYTE> output(stride * height, 0xCD);
+
+	FillDxtBlocks(blocks.data(), format, blockCount, seed);
+
+	DecodeReference(blocks.data(), format, width, height, expected.data(), stride);
+	DecodeDXT(blocks.data(), format, width, height, output.data(), stride);
+
+	BOOL match = memcmp(expected.data(), output.data(), expected.size()) == 0;
+
+	if (!match) {
+		printf("DecodeDXT %s, %.4s %dx%d\n", level->Name, (const char*)&format, width, height);
+	}
+
+	TEST_CHECK(match);
+}
+
+
+// One block with the pixels it must decode to, as B, G, R, A in a UINT32.
+struct DXT_KNOWN_BLOCK {
+	const char* Name;
+	DWORD Format;
+	BYTE Block[16];
+	UINT32 Pixels[16];
+};
+
+
+// Endpoints are pure 5:6:5 blue (0x001F), red (0xF800) or green (0x07E0), so
+// the expected colors follow from the spec alone. Indices 0xE4 give each row
+// codes 0, 1, 2, 3.
+static const DXT_KNOWN_BLOCK g_dxtKnownBlocks[] = {
+	{
+		"DXT1 four colors", DXT_FORMAT_DXT1,
+		{ 0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4 },
+		{
+			0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA,
+			0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA,
+			0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA,
+			0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA
+		}
+	},
+	{
+		// color0 <= color1: code 2 is the midpoint, code 3 transparent black
+		"DXT1 1-bit alpha", DXT_FORMAT_DXT1,
+		{ 0x1F, 0x00, 0x00, 0xF8, 0xE4, 0xE4, 0xE4, 0xE4 },
+		{
+			0xFF0000FF, 0xFFFF0000, 0xFF7F007F, 0x00000000,
+			0xFF0000FF, 0xFFFF0000, 0xFF7F007F, 0x00000000,
+			0xFF0000FF, 0xFFFF0000, 0xFF7F007F, 0x00000000,
+			0xFF0000FF, 0xFFFF0000, 0xFF7F007F, 0x00000000
+		}
+	},
+	{
+		// Equal endpoints are the three color mode as well
+		"DXT1 equal endpoints", DXT_FORMAT_DXT1,
+		{ 0xE0, 0x07, 0xE0, 0x07, 0xE4, 0xE4, 0xE4, 0xE4 },
+		{
+			0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0x00000000,
+			0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0x00000000,
+			0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0x00000000,
+			0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0x00000000
+		}
+	},
+	{
+		// Pixel i has alpha nibble i, expanded to i * 17
+		"DXT3 4-bit alpha", DXT_FORMAT_DXT3,
+		{
+			0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE,
+			0x00, 0xF8, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00
+		},
+		{
+			0x00FF0000, 0x11FF0000, 0x22FF0000, 0x33FF0000,
+			0x44FF0000, 0x55FF0000, 0x66FF0000, 0x77FF0000,
+			0x88FF0000, 0x99FF0000, 0xAAFF0000, 0xBBFF0000,
+			0xCCFF0000, 0xDDFF0000, 0xEEFF0000, 0xFFFF0000
+		}
+	}
+};
+
+
+// The block is decoded twice side by side, so the kernels that work on
+// pairs of blocks see it too.
+static VOID CheckKnownBlock(PCTEST_CPU_LEVEL level, const DXT_KNOWN_BLOCK* known) {
+	INT32 blockSize = GetDXTBlockSize(known->Format);
+
+	BYTE blocks[32];
+	memcpy(blocks, known->Block, blockSize);
+	memcpy(blocks + blockSize, known->Block, blockSize);
+
+	UINT32 output[4][8];
+	DecodeDXT(blocks, known->Format, 8, 4, (BYTE*)output, sizeof(output[0]));
+
+	BOOL match = TRUE;
+
+	for (INT32 y = 0; y < 4; y++) {
+		for (INT32 x = 0; x < 8; x++) {
+			match &= output[y][x] == known->Pixels[y * 4 + x % 4];
+		}
+	}
+
+	if (!match) {
+		printf("DecodeDXT %s, %s\n", level->Name, known->Name);
+	}
+
+	TEST_CHECK(match);
+}
+
+
+// Decodes the whole blocks into a buffer of their own and copies the image
+// out of it, what the loaders did before the decoders clipped edge blocks.
+static VOID DecodeCropped(const BYTE* input, DWORD format, INT32 width, INT32 height, INT32 pixelSize, BYTE* output, size_t stride) {
+	INT32 blockWidth = (width + 3) & ~3;
+	INT32 blockHeight = (height + 3) & ~3;
+	size_t blockStride = (size_t)blockWidth * pixelSize;
+
+	std::vector<BYTE> blocks(blockStride * blockHeight);
+
+	if (pixelSize == 4) {
+		DecodeDXT(input, format, blockWidth, blockHeight, blocks.data(), blockStride);
+	}
+	else {
+		DecodeDXTRGB(input, format, blockWidth, blockHeight, blocks.data(), blockStride);
+	}
+
+	for (INT32 y = 0; y < height; y++) {
+		memcpy(output + y * stride, &blocks[y * blockStride], (size_t)width * pixelSize);
+	}
+}
+
+
+// Edge blocks written straight into a padded buffer give the same pixels as
+// cropping a whole block decode, and nothing past the image.
+static VOID CheckEdgeClipping(PCTEST_CPU_LEVEL level, DWORD format, INT32 width, INT32 height, INT32 pixelSize, UINT32* seed) {
+	INT32 blockCount = ((width + 3) / 4) * ((height + 3) / 4);
+	size_t stride = (size_t)width * pixelSize + DXT_TEST_ROW_PADDING;
+
+	std::vector<BYTE> blocks((size_t)blockCount * GetDXTBlockSize(format));
+	std::vector<BYTE> expected(stride * height, 0xCD);
+	std::vector<BYTE> output(stride * height, 0xCD);
+
+	FillDxtBlocks(blocks.data(), format, blockCount, seed);
+
+	DecodeCropped(blocks.data(), format, width, height, pixelSize, expected.data(), stride);
+
+	if (pixelSize == 4) {
+		DecodeDXT(blocks.data(), format, width, height, output.data(), stride);
+	}
+	else {
+		DecodeDXTRGB(blocks.data(), format, width, height, output.data(), stride);
+	}
+
+	BOOL match = memcmp(expected.data(), output.data(), expected.size()) == 0;
+
+	if (!match) {
+		printf("%s %s, %.4s %dx%d differs from a cropped decode\n", pixelSize == 4 ? "DecodeDXT" : "DecodeDXTRGB", level->Name, (const char*)&format, width, height);
+	}
+
+	TEST_CHECK(match);
+}
+
+
+VOID RunDxtTests() {
+	UINT32 seed = 9;
+
+	for (INT32 i = 0; i < g_testCpuLevelCount; i++) {
+		PCTEST_CPU_LEVEL level = &g_testCpuLevels[i];
+
+		if (!SelectTestCpuLevel(level)) {
+			printf("dxt: %s not supported, skipped\n", level->Name);
+			continue;
+		}
+
+		for (INT32 f = 0; f < ARRAYSIZE(g_dxtTestFormats); f++) {
+			for (INT32 h = 0; h < ARRAYSIZE(g_dxtTestHeights); h++) {
+				for (INT32 w = 0; w < ARRAYSIZE(g_dxtTestWidths); w++) {
+					CheckDecodeDXT(level, g_dxtTestFormats[f], g_dxtTestWidths[w], g_dxtTestHeights[h], &seed);
+				}
+			}
+		}
+
+		for (INT32 j = 0; j < ARRAYSIZE(g_dxtKnownBlocks); j++) {
+			CheckKnownBlock(level, &g_dxtKnownBlocks[j]);
+		}
+
+		for (INT32 f = 0; f < ARRAYSIZE(g_dxtEdgeTestFormats); f++) {
+			for (INT32 h = 0; h < ARRAYSIZE(g_dxtEdgeTestSizes); h++) {
+				for (INT32 w = 0; w < ARRAYSIZE(g_dxtEdgeTestSizes); w++) {
+					CheckEdgeClipping(level, g_dxtEdgeTestFormats[f], g_dxtEdgeTestSizes[w], g_dxtEdgeTestSizes[h], 4, &seed);
+					CheckEdgeClipping(level, g_dxtEdgeTestFormats[f], g_dxtEdgeTestSizes[w], g_dxtEdgeTestSizes[h], 3, &seed);
+				}
+			}
+		}
+	}
+
+	ResetTestCpuLevel();
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../SpriteFile.h"
+
+
+struct LOADER_BENCHMARK_SIZE {
+	INT32 FrameCount;
+	INT32 Width;
+	INT32 Height;
+};
+
+
+static const LOADER_BENCHMARK_SIZE g_loaderBenchmarkSizes[] = {
+	{ 1, 64, 64 },
+	{ 8, 64, 64 },
+	{ 64, 64, 64 },
+	{ 256, 64, 64 },
+	{ 1, 512, 512 },
+	{ 16, 512, 512 }
+};
+
+
+struct LOADER_BENCHMARK {
+	PTEST_STREAM Stream;
+	BOOL FirstFrame;
+	HRESULT Result;
+};
+
+
+static VOID RunLoad(PVOID context) {
+	LOADER_BENCHMARK* benchmark = (LOADER_BENCHMARK*)context;
+
+	LARGE_INTEGER start = {};
+	benchmark->Stream->Seek(start, STREAM_SEEK_SET, NULL);
+
+	STREAM_READER reader;
+	InitStreamReader(&reader, benchmark->Stream);
+
+	PSPRITE_FILE sprite;
+
+	if (benchmark->FirstFrame) {
+		benchmark->Result = LoadSpriteFileFrame(&reader, 0, &sprite);
+	}
+	else {
+		benchmark->Result = LoadSpriteFile(&reader, &sprite);
+	}
+
+	if (SUCCEEDED(benchmark->Result)) {
+		FreeSpriteFile(sprite);
+	}
+}
+
+
+// Bytes and Read calls of one load, then the time per load.
+static VOID MeasureLoad(LOADER_BENCHMARK* benchmark, ULONGLONG* bytes, ULONG* reads, double* seconds) {
+	ULONGLONG bytesBefore = benchmark->Stream->BytesRead;
+	ULONG readsBefore = benchmark->Stream->ReadCount;
+
+	RunLoad(benchmark);
+
+	*bytes = benchmark->Stream->BytesRead - bytesBefore;
+	*reads = benchmark->Stream->ReadCount - readsBefore;
+	*seconds = TimeBenchmark(RunLoad, benchmark);
+}
+
+
+// What LoadSpriteFileFrame saves over LoadSpriteFile when only the first
+// frame is wanted, in bytes pulled from the stream and time per file.
+VOID RunLoaderBenchmark() {
+	UINT32 seed = 1;
+
+	printf("%-14s %10s %12s %8s %10s %12s %8s %10s\n", "file", "KiB", "all KiB", "reads", "all us", "first KiB", "reads", "first us");
+
+	for (INT32 i = 0; i < ARRAYSIZE(g_loaderBenchmarkSizes); i++) {
+		const LOADER_BENCHMARK_SIZE* size = &g_loaderBenchmarkSizes[i];
+
+		std::vector<BYTE> file;
+		WriteSpriteV2(file, size->FrameCount, size->Width, size->Height, &seed);
+
+		LOADER_BENCHMARK benchmark = {};
+
+		if (FAILED(CreateTestStream(file.data(), (ULONG)file.size(), 0, &benchmark.Stream))) {
+			continue;
+		}
+
+		ULONGLONG allBytes, firstBytes;
+		ULONG allReads, firstReads;
+		double allSeconds, firstSeconds;
+
+		benchmark.FirstFrame = FALSE;
+		MeasureLoad(&benchmark, &allBytes, &allReads, &allSeconds);
+
+		HRESULT allResult = benchmark.Result;
+
+		benchmark.FirstFrame = TRUE;
+		MeasureLoad(&benchmark, &firstBytes, &firstReads, &firstSeconds);
+
+		benchmark.Stream->Release();
+
+		char name[32];
+		sprintf_s(name, sizeof(name), "%dx%dx%d", size->FrameCount, size->Width, size->Height);
+
+		if (FAILED(allResult) || FAILED(benchmark.Result)) {
+			printf("%-14s failed\n", name);
+			continue;
+		}
+
+		printf("%-14s %10u %12.1f %8u %10.1f %12.1f %8u %10.1f\n", name, (UINT32)(file.size() / 1024),
+			allBytes / 1024.0, allReads, allSeconds * 1e6,
+			firstBytes / 1024.0, firstReads, firstSeconds * 1e6);
+	}
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../DxtDecode.h"
+
+
+#define MEMORY_BENCHMARK_SIZE 2048
+
+// Same limits the thumbnail provider uses by default
+#define MEMORY_BENCHMARK_THUMBNAIL_SIZE 256
+#define MEMORY_BENCHMARK_MEMORY_LIMIT   (16 * 1024 * 1024)
+
+
+#ifdef _DEBUG
+
+// Heap bytes allocated since the measurement started, and the most there
+// were at once. Blocks from before the start may be freed during it, so the
+// count can go below zero.
+static LONGLONG g_liveBytes = 0;
+static LONGLONG g_peakBytes = 0;
+
+
+static int __cdecl TrackAllocation(int allocType, void* userData, size_t size, int blockType, long, const unsigned char*, int) {
+	if (blockType == _CRT_BLOCK) {
+		return TRUE;
+	}
+
+	switch (allocType) {
+		case _HOOK_ALLOC: {
+			g_liveBytes += (LONGLONG)size;
+			break;
+		}
+		case _HOOK_REALLOC: {
+			g_liveBytes += (LONGLONG)size - (LONGLONG)_msize_dbg(userData, blockType);
+			break;
+		}
+		case _HOOK_FREE: {
+			g_liveBytes -= (LONGLONG)_msize_dbg(userData, blockType);
+			break;
+		}
+	}
+
+	g_peakBytes = max(g_peakBytes, g_liveBytes);
+
+	return TRUE;
+}
+
+#endif
+
+
+// Loads the thumbnail frame and reads all its rows, returns the heap high
+// water mark in bytes, or -1 when loading failed or the build cannot
+// measure it.
+static LONGLONG MeasureLoad(const std::vector<BYTE>& file, size_t memoryLimit, double* seconds) {
+	PTEST_STREAM stream;
+
+	if (FAILED(CreateTestStream(file.data(), (ULONG)file.size(), 0, &stream))) {
+		return -1;
+	}
+
+	LONGLONG peak = -1;
+
+#ifdef _DEBUG
+	g_liveBytes = 0;
+	g_peakBytes = 0;
+
+	_CRT_ALLOC_HOOK previousHook = _CrtSetAllocHook(TrackAllocation);
+#endif
+
+	LONGLONG start = GetTimestamp();
+
+	SPRITE_IMAGE image;
+
+	HRESULT hr = LoadSpriteImage(stream, MEMORY_BENCHMARK_THUMBNAIL_SIZE, memoryLimit, &image);
+
+	if (SUCCEEDED(hr)) {
+		hr = ReadTestImageRows(&image);
+		FreeSpriteImage(&image);
+	}
+
+	*seconds = GetElapsedSeconds(start);
+
+#ifdef _DEBUG
+	_CrtSetAllocHook(previousHook);
+
+	peak = g_peakBytes;
+#endif
+
+	stream->Release();
+
+	return SUCCEEDED(hr) ? peak : -1;
+}
+
+
+// Heap high water mark of loading 2048x2048 frames for a 256 pixel
+// thumbnail, against the 16 MiB a whole frame of BGRA pixels takes. The
+// heap is only tracked in Debug builds, Release builds give the times.
+VOID RunMemoryBenchmark() {
+	struct MEMORY_BENCHMARK_FILE {
+		const char* Name;
+		DWORD Format;
+		INT32 MipCount;
+	};
+
+	static const MEMORY_BENCHMARK_FILE files[] = {
+		{ "v2 indices", 0, 0 },
+		{ "v3 DXT1", DXT_FORMAT_DXT1, 1 },
+		{ "v3 DXT5", DXT_FORMAT_DXT5, 1 },
+		{ "v3 BC7", DXT_FORMAT_BC7, 1 },
+		{ "v3 DXT5 mips", DXT_FORMAT_DXT5, 12 }
+	};
+
+	static const size_t limits[] = { MEMORY_BENCHMARK_MEMORY_LIMIT, MEMORY_BENCHMARK_MEMORY_LIMIT / 4 };
+
+#ifndef _DEBUG
+	printf("heap tracking needs a Debug build, only times are shown\n");
+#endif
+
+	printf("whole frame %d KiB\n", MEMORY_BENCHMARK_SIZE * MEMORY_BENCHMARK_SIZE * 4 / 1024);
+	printf("%-16s %10s %14s %10s\n", "file", "limit KiB", "peak KiB", "ms");
+
+	UINT32 seed = 1;
+
+	for (INT32 i = 0; i < ARRAYSIZE(files); i++) {
+		std::vector<BYTE> file;
+
+		if (files[i].Format == 0) {
+			WriteSpriteV2(file, 1, MEMORY_BENCHMARK_SIZE, MEMORY_BENCHMARK_SIZE, &seed);
+		}
+		else {
+			WriteSpriteV3(file, 1, MEMORY_BENCHMARK_SIZE, MEMORY_BENCHMARK_SIZE, files[i].Format, files[i].MipCount, &seed);
+		}
+
+		for (INT32 j = 0; j < ARRAYSIZE(limits); j++) {
+			double seconds;
+
+			LONGLONG peak = MeasureLoad(file, limits[j], &seconds);
+
+			char peakText[32] = "-";
+
+			if (peak >= 0) {
+				sprintf_s(peakText, sizeof(peakText), "%lld", peak / 1024);
+			}
+
+			printf("%-16s %10u %14s %10.2f\n", files[i].Name, (UINT32)(limits[j] / 1024), peakText, seconds * 1e3);
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../BoxDownscale.h"
+#include "../PaletteExpand.h"
+
+
+// A large frame, still small enough to stay in the L2 cache
+#define PALETTE_BENCHMARK_PIXELS (512 * 512)
+
+
+struct PALETTE_BENCHMARK {
+	UINT32 Lut[256];
+	std::vector<BYTE> Indices;
+	std::vector<BYTE> Pixels;
+};
+
+
+static VOID RunExpand32(PVOID context) {
+	PALETTE_BENCHMARK* benchmark = (PALETTE_BENCHMARK*)context;
+
+	ExpandIndices32(benchmark->Lut, benchmark->Indices.data(), benchmark->Pixels.data(), benchmark->Indices.size());
+}
+
+
+static VOID RunExpand24(PVOID context) {
+	PALETTE_BENCHMARK* benchmark = (PALETTE_BENCHMARK*)context;
+
+	ExpandIndices24(benchmark->Lut, benchmark->Indices.data(), benchmark->Pixels.data(), benchmark->Indices.size());
+}
+
+
+struct PALETTE_DOWNSCALE_BENCHMARK {
+	UINT32 Lut[256];
+	INT32 Width;
+	INT32 Height;
+	INT32 Factor;
+	std::vector<BYTE> Indices;
+	std::vector<BYTE> Pixels;
+	std::vector<BYTE> Output;
+};
+
+
+// The path before the palette domain downscale, the whole image expanded
+static VOID RunExpandThenBox(PVOID context) {
+	PALETTE_DOWNSCALE_BENCHMARK* benchmark = (PALETTE_DOWNSCALE_BENCHMARK*)context;
+
+	INT32 newWidth = benchmark->Width / benchmark->Factor;
+	INT32 newHeight = benchmark->Height / benchmark->Factor;
+
+	ExpandIndices32(benchmark->Lut, benchmark->Indices.data(), benchmark->Pixels.data(), benchmark->Indices.size());
+	BoxDownscale(benchmark->Pixels.data(), benchmark->Width, benchmark->Height, benchmark->Width * 4, benchmark->Output.data(), newWidth, newHeight, newWidth * 4);
+}
+
+
+static VOID RunDownscaleIndices(PVOID context) {
+	PALETTE_DOWNSCALE_BENCHMARK* benchmark = (PALETTE_DOWNSCALE_BENCHMARK*)context;
+
+	DownscaleIndices32(benchmark->Lut, benchmark->Indices.data(), benchmark->Width, benchmark->Height, benchmark->Factor,
+		benchmark->Output.data(), (size_t)(benchmark->Width / benchmark->Factor) * 4);
+}
+
+
+// Whole factor thumbnails of paletted frames, DownscaleIndices32 against
+// ExpandIndices32 followed by BoxDownscale, at the detected features.
+static VOID RunDownscaleBenchmark(const UINT32* lut) {
+	static const INT32 sizes[][3] = {
+		{ 256, 256, 2 },
+		{ 512, 512, 4 },
+		{ 300, 300, 3 },
+		{ 512, 512, 8 },
+		{ 1024, 1024, 4 },
+		{ 2048, 2048, 8 }
+	};
+
+	UINT32 seed = 2;
+
+	printf("%-20s %16s %16s %8s\n", "size", "expand+box us", "indices us", "speedup");
+
+	for (INT32 i = 0; i < ARRAYSIZE(sizes); i++) {
+		PALETTE_DOWNSCALE_BENCHMARK benchmark;
+
+		memcpy(benchmark.Lut, lut, sizeof(benchmark.Lut));
+		benchmark.Width = sizes[i][0];
+		benchmark.Height = sizes[i][1];
+		benchmark.Factor = sizes[i][2];
+		benchmark.Indices.resize((size_t)benchmark.Width * benchmark.Height);
+		benchmark.Pixels.resize(benchmark.Indices.size() * 4);
+		benchmark.Output.resize(benchmark.Indices.size() * 4 / (benchmark.Factor * benchmark.Factor));
+
+		FillRandom(benchmark.Indices.data(), benchmark.Indices.size(), &seed);
+
+		double expandSeconds = TimeBenchmark(RunExpandThenBox, &benchmark);
+		double indicesSeconds = TimeBenchmark(RunDownscaleIndices, &benchmark);
+
+		char name[32];
+		sprintf_s(name, sizeof(name), "%dx%d by %d", benchmark.Width, benchmark.Height, benchmark.Factor);
+
+		printf("%-20s %16.1f %16.1f %7.2fx\n", name, expandSeconds * 1e6, indicesSeconds * 1e6, expandSeconds / indicesSeconds);
+	}
+}
+
+
+VOID RunPaletteBenchmark() {
+	UINT32 seed = 1;
+
+	PALETTE_BENCHMARK benchmark;
+
+	for (INT32 i = 0; i < 256; i++) {
+		benchmark.Lut[i] = NextRandom(&seed) | 0xFF000000;
+	}
+
+	benchmark.Indices.resize(PALETTE_BENCHMARK_PIXELS);
+	benchmark.Pixels.resize(PALETTE_BENCHMARK_PIXELS * 4);
+
+	FillRandom(benchmark.Indices.data(), benchmark.Indices.size(), &seed);
+
+	printf("%-8s %16s %16s\n", "level", "32-bit Mpx/s", "24-bit Mpx/s");
+
+	for (INT32 i = 0; i < g_testCpuLevelCount; i++) {
+		PCTEST_CPU_LEVEL level = &g_testCpuLevels[i];
+
+		if (!SelectTestCpuLevel(level)) {
+			continue;
+		}
+
+		double seconds32 = TimeBenchmark(RunExpand32, &benchmark);
+		double seconds24 = TimeBenchmark(RunExpand24, &benchmark);
+
+		printf("%-8s %16.1f %16.1f\n", level->Name,
+			PALETTE_BENCHMARK_PIXELS / seconds32 / 1e6,
+			PALETTE_BENCHMARK_PIXELS / seconds24 / 1e6);
+	}
+
+	ResetTestCpuLevel();
+
+	RunDownscaleBenchmark(benchmark.Lut);
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Tests.h"
+#include "TestSupport.h"
+#include "../BoxDownscale.h"
+#include "../PaletteExpand.h"
+
+
+// Bytes after the expected output that must stay untouched
+#define PALETTE_TEST_GUARD 64
+
+
+static const size_t g_paletteTestCounts[] = {
+	0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 24, 25, 31, 32, 33, 47, 63, 64, 65, 100, 255, 256, 257, 1000, 4099
+};
+
+
+// Index images and the factor they shrink by. Factors of 2 and 4 have their
+// own paths, blocks over 64 pixels divide without the table and blocks over
+// 257 pixels move their sums out of the 16-bit lanes more than once.
+static const INT32 g_paletteDownscaleSizes[][3] = {
+	{ 2, 2, 2 },
+	{ 8, 6, 2 },
+	{ 16, 16, 4 },
+	{ 12, 8, 4 },
+	{ 9, 9, 3 },
+	{ 40, 20, 5 },
+	{ 64, 64, 8 },
+	{ 48, 48, 16 },
+	{ 34, 51, 17 },
+	{ 300, 300, 150 }
+};
+
+
+static VOID CheckExpandIndices(PCTEST_CPU_LEVEL level, const UINT32* lut, const BYTE* src, size_t count) {
+	std::vector<BYTE> expected(count * 4 + PALETTE_TEST_GUARD, 0xCD);
+	std::vector<BYTE> output(count * 4 + PALETTE_TEST_GUARD, 0xCD);
+
+	// 32-bit
+	for (size_t i = 0; i < count; i++) {
+		memcpy(&expected[i * 4], &lut[src[i]], 4);
+	}
+
+	ExpandIndices32(lut, src, output.data(), count);
+
+	BOOL match = memcmp(expected.data(), output.data(), expected.size()) == 0;
+
+	if (!match) {
+		printf("ExpandIndices32 %s, %u pixels\n", level->Name, (UINT32)count);
+	}
+
+	TEST_CHECK(match);
+
+	// 24-bit
+	memset(expected.data(), 0xCD, expected.size());
+	memset(output.data(), 0xCD, output.size());
+
+	for (size_t i = 0; i < count; i++) {
+		memcpy(&expected[i * 3], &lut[src[i]], 3);
+	}
+
+	ExpandIndices24(lut, src, output.data(), count);
+
+	match = memcmp(expected.data(), output.data(), expected.size()) == 0;
+
+	if (!match) {
+		printf("ExpandIndices24 %s, %u pixels\n", level->Name, (UINT32)count);
+	}
+
+	TEST_CHECK(match);
+}
+
+
+// Same bytes as expanding the indices and box filtering the pixels. Rows
+// are padded, the padding must stay untouched.
+static VOID CheckDownscaleIndices(PCTEST_CPU_LEVEL level, const UINT32* lut, INT32 width, INT32 height, INT32 factor, UINT32* seed) {
+	INT32 newWidth = width / factor;
+	INT32 newHeight = height / factor;
+	size_t stride = (size_t)newWidth * 4 + PALETTE_TEST_GUARD;
+
+	std::vector<BYTE> src((size_t)width * height);
+	std::vector<BYTE> pixels(src.size() * 4);
+	std::vector<BYTE> expected(stride * newHeight, 0xCD);
+	std::vector<BYTE> output(stride * newHeight, 0xCD);
+
+	FillRandom(src.data(), src.size(), seed);
+
+	ExpandIndices32(lut, src.data(), pixels.data(), src.size());
+
+	HRESULT hr = BoxDownscale(pixels.data(), width, height, width * 4, expected.data(), newWidth, newHeight, (INT32)stride);
+	TEST_CHECK(SUCCEEDED(hr));
+
+	DownscaleIndices32(lut, src.data(), width, height, factor, output.data(), stride);
+
+	BOOL match = memcmp(expected.data(), output.data(), expected.size()) == 0;
+
+	if (!match) {
+		printf("DownscaleIndices32 %s, %dx%d by %d\n", level->Name, width, height, factor);
+	}
+
+	TEST_CHECK(match);
+}
+
+
+VOID RunPaletteTests() {
+	UINT32 seed = 1;
+
+	UINT32 lut[256];
+
+	for (INT32 i = 0; i < 256; i++) {
+		lut[i] = NextRandom(&seed) | (NextRandom(&seed) << 24);
+	}
+
+	for (INT32 i = 0; i < g_testCpuLevelCount; i++) {
+		PCTEST_CPU_LEVEL level = &g_testCpuLevels[i];
+
+		if (!SelectTestCpuLevel(level)) {
+			printf("palette: %s not supported, skipped\n", level->Name);
+			continue;
+		}
+
+		for (INT32 j = 0; j < ARRAYSIZE(g_paletteTestCounts); j++) {
+			size_t count = g_paletteTestCounts[j];
+
+			// Offset by one so the kernels also see unaligned sources
+			std::vector<BYTE> src(count + 1);
+
+			FillRandom(src.data(), src.size(), &seed);
+
+			CheckExpandIndices(level, lut, src.data() + 1, count);
+		}
+
+		// Palette entries are opaque, like BuildPaletteLUT makes them
+		UINT32 opaqueLut[256];
+
+		for (INT32 j = 0; j < 256; j++) {
+			opaqueLut[j] = lut[j] | 0xFF000000;
+		}
+
+		for (INT32 j = 0; j < ARRAYSIZE(g_paletteDownscaleSizes); j++) {
+			CheckDownscaleIndices(level, opaqueLut, g_paletteDownscaleSizes[j][0], g_paletteDownscaleSizes[j][1], g_paletteDownscaleSizes[j][2], &seed);
+		}
+	}
+
+	ResetTestCpuLevel();
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+
+
+#define PROBE_BENCHMARK_FILES 4000
+
+
+struct PROBE_BENCHMARK {
+	INT32 Files;
+	INT32 Failed;
+	INT32 Frames;
+	ULONGLONG BytesRead;
+};
+
+
+static VOID ProbeFile(LPCWSTR path, PROBE_BENCHMARK* benchmark) {
+	PTEST_STREAM stream;
+
+	HRESULT hr = OpenTestStream(path, 0, &stream);
+
+	if (SUCCEEDED(hr)) {
+		SPRITE_PROBE probe;
+
+		hr = ProbeSprite(stream, &probe);
+
+		if (SUCCEEDED(hr)) {
+			benchmark->Frames += probe.Count;
+			FreeSpriteProbe(&probe);
+		}
+
+		benchmark->BytesRead += stream->BytesRead;
+		stream->Release();
+	}
+
+	benchmark->Files++;
+
+	if (FAILED(hr)) {
+		benchmark->Failed++;
+	}
+}
+
+
+// Probes every .spr file under the directory and its subdirectories, the
+// way an indexer would walk a tree.
+static VOID ProbeDirectory(LPCWSTR directory, PROBE_BENCHMARK* benchmark) {
+	WCHAR pattern[MAX_PATH];
+	swprintf_s(pattern, ARRAYSIZE(pattern), L"%ls\\*", directory);
+
+	WIN32_FIND_DATAW findData;
+
+	HANDLE find = FindFirstFileW(pattern, &findData);
+	if (find == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	do {
+		if (wcscmp(findData.cFileName, L".") == 0 || wcscmp(findData.cFileName, L"..") == 0) {
+			continue;
+		}
+
+		WCHAR path[MAX_PATH];
+		swprintf_s(path, ARRAYSIZE(path), L"%ls\\%ls", directory, findData.cFileName);
+
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			ProbeDirectory(path, benchmark);
+			continue;
+		}
+
+		size_t length = wcslen(findData.cFileName);
+
+		if (length >= 4 && _wcsicmp(findData.cFileName + length - 4, L".spr") == 0) {
+			ProbeFile(path, benchmark);
+		}
+	} while (FindNextFileW(find, &findData));
+
+	FindClose(find);
+}
+
+
+struct PROBE_BENCHMARK_RUN {
+	const TEST_CORPUS* Corpus;
+	PROBE_BENCHMARK Result;
+};
+
+
+static VOID RunProbe(PVOID context) {
+	PROBE_BENCHMARK_RUN* run = (PROBE_BENCHMARK_RUN*)context;
+
+	memset(&run->Result, 0, sizeof(run->Result));
+
+	ProbeDirectory(run->Corpus->Root.c_str(), &run->Result);
+}
+
+
+// ProbeSprite throughput in files per second over a generated tree of a few
+// thousand v2 and v3 sprites in the temp folder, directory walk included.
+// The files stay in the system cache after the first pass.
+VOID RunProbeBenchmark() {
+	UINT32 seed = 25;
+
+	TEST_CORPUS corpus;
+
+	HRESULT hr = WriteTestCorpus(PROBE_BENCHMARK_FILES, &corpus, &seed);
+	if (FAILED(hr)) {
+		printf("cannot write the corpus, 0x%08X\n", (UINT32)hr);
+		return;
+	}
+
+	PROBE_BENCHMARK_RUN run;
+	run.Corpus = &corpus;
+
+	double seconds = TimeBenchmark(RunProbe, &run);
+
+	printf("%d files in %u directories, %.1f MiB\n", run.Result.Files, (UINT32)corpus.Directories.size(), corpus.TotalBytes / (1024.0 * 1024.0));
+
+	if (run.Result.Failed != 0) {
+		printf("%d probes failed\n", run.Result.Failed);
+	}
+
+	printf("%-16s %12s %14s %18s\n", "", "files/s", "frames/s", "KiB read per file");
+	printf("%-16s %12.0f %14.0f %18.2f\n", "ProbeSprite", run.Result.Files / seconds, run.Result.Frames / seconds,
+		run.Result.BytesRead / 1024.0 / max(run.Result.Files, 1));
+
+	DeleteTestCorpus(&corpus);
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../BoxDownscale.h"
+#include "../ResizeCache.h"
+#include "../stb_image_resize2.h"
+
+
+struct RESIZE_BENCHMARK {
+	INT32 Width;
+	INT32 Height;
+	INT32 NewWidth;
+	INT32 NewHeight;
+	std::vector<BYTE> Input;
+	std::vector<BYTE> Output;
+};
+
+
+static VOID RunStb(PVOID context) {
+	RESIZE_BENCHMARK* benchmark = (RESIZE_BENCHMARK*)context;
+
+	stbir_resize(benchmark->Input.data(), benchmark->Width, benchmark->Height, benchmark->Width * 4,
+		benchmark->Output.data(), benchmark->NewWidth, benchmark->NewHeight, benchmark->NewWidth * 4,
+		STBIR_BGRA, STBIR_TYPE_UINT8, STBIR_EDGE_ZERO, STBIR_FILTER_DEFAULT);
+}
+
+
+static VOID RunBox(PVOID context) {
+	RESIZE_BENCHMARK* benchmark = (RESIZE_BENCHMARK*)context;
+
+	BoxDownscale(benchmark->Input.data(), benchmark->Width, benchmark->Height, benchmark->Width * 4,
+		benchmark->Output.data(), benchmark->NewWidth, benchmark->NewHeight, benchmark->NewWidth * 4);
+}
+
+
+static VOID RunCached(PVOID context) {
+	RESIZE_BENCHMARK* benchmark = (RESIZE_BENCHMARK*)context;
+
+	CachedResize(benchmark->Input.data(), benchmark->Width, benchmark->Height, benchmark->Width * 4,
+		benchmark->Output.data(), benchmark->NewWidth, benchmark->NewHeight, benchmark->NewWidth * 4, STBIR_BGRA);
+}
+
+
+// The same thumbnail over and over, one-shot stbir_resize against
+// CachedResize reusing its samplers. Small thumbnails gain the most, their
+// filter setup is a large part of the work.
+static VOID RunCachedBenchmark() {
+	static const INT32 sizes[][4] = {
+		{ 32, 32, 24, 24 },
+		{ 64, 64, 48, 48 },
+		{ 200, 150, 96, 72 },
+		{ 100, 300, 85, 256 },
+		{ 320, 240, 256, 192 },
+		{ 512, 512, 96, 96 }
+	};
+
+	UINT32 seed = 2;
+
+	printf("%-20s %14s %14s %8s\n", "size", "one-shot us", "cached us", "speedup");
+
+	for (INT32 i = 0; i < ARRAYSIZE(sizes); i++) {
+		RESIZE_BENCHMARK benchmark;
+
+		benchmark.Width = sizes[i][0];
+		benchmark.Height = sizes[i][1];
+		benchmark.NewWidth = sizes[i][2];
+		benchmark.NewHeight = sizes[i][3];
+		benchmark.Output.resize((size_t)benchmark.NewWidth * benchmark.NewHeight * 4);
+
+		MakeTestImage(TEST_IMAGE_CUTOUT, benchmark.Width, benchmark.Height, benchmark.Input, &seed);
+
+		double oneShotSeconds = TimeBenchmark(RunStb, &benchmark);
+		double cachedSeconds = TimeBenchmark(RunCached, &benchmark);
+
+		char name[32];
+		sprintf_s(name, sizeof(name), "%dx%d to %dx%d", benchmark.Width, benchmark.Height, benchmark.NewWidth, benchmark.NewHeight);
+
+		printf("%-20s %14.1f %14.1f %7.2fx\n", name, oneShotSeconds * 1e6, cachedSeconds * 1e6, oneShotSeconds / cachedSeconds);
+	}
+
+	FreeResizeCache();
+}
+
+
+// Whole factor thumbnails, BoxDownscale at each level against the stb
+// default filter the provider uses for other sizes. The PSNR columns show
+// how far the box result is from that filter's.
+VOID RunResizeBenchmark() {
+	static const INT32 sizes[][4] = {
+		{ 256, 256, 128, 128 },
+		{ 256, 256, 64, 64 },
+		{ 512, 512, 32, 32 },
+		{ 1024, 1024, 256, 256 },
+		{ 96, 96, 32, 32 },
+		{ 300, 300, 100, 100 }
+	};
+
+	UINT32 seed = 1;
+
+	printf("%-20s %10s", "size", "stb us");
+
+	for (INT32 i = 0; i < g_testCpuLevelCount; i++) {
+		if (SelectTestCpuLevel(&g_testCpuLevels[i])) {
+			printf(" %8s us %7s", g_testCpuLevels[i].Name, "speedup");
+		}
+	}
+
+	printf(" %14s %14s\n", "gradient PSNR", "cutout PSNR");
+
+	for (INT32 i = 0; i < ARRAYSIZE(sizes); i++) {
+		RESIZE_BENCHMARK benchmark;
+
+		benchmark.Width = sizes[i][0];
+		benchmark.Height = sizes[i][1];
+		benchmark.NewWidth = sizes[i][2];
+		benchmark.NewHeight = sizes[i][3];
+		benchmark.Output.resize((size_t)benchmark.NewWidth * benchmark.NewHeight * 4);
+
+		MakeTestImage(TEST_IMAGE_NOISE, benchmark.Width, benchmark.Height, benchmark.Input, &seed);
+
+		char name[32];
+		sprintf_s(name, sizeof(name), "%dx%d to %dx%d", benchmark.Width, benchmark.Height, benchmark.NewWidth, benchmark.NewHeight);
+
+		ResetTestCpuLevel();
+
+		double stbSeconds = TimeBenchmark(RunStb, &benchmark);
+
+		printf("%-20s %10.1f", name, stbSeconds * 1e6);
+
+		for (INT32 j = 0; j < g_testCpuLevelCount; j++) {
+			if (!SelectTestCpuLevel(&g_testCpuLevels[j])) {
+				continue;
+			}
+
+			double boxSeconds = TimeBenchmark(RunBox, &benchmark);
+
+			printf(" %11.1f %6.1fx", boxSeconds * 1e6, stbSeconds / boxSeconds);
+		}
+
+		ResetTestCpuLevel();
+
+		for (INT32 kind = TEST_IMAGE_GRADIENT; kind <= TEST_IMAGE_CUTOUT; kind++) {
+			MakeTestImage(kind, benchmark.Width, benchmark.Height, benchmark.Input, &seed);
+
+			RunStb(&benchmark);
+			std::vector<BYTE> stb = benchmark.Output;
+
+			RunBox(&benchmark);
+
+			printf(" %11.1f dB", GetPSNR(benchmark.Output, stb));
+		}
+
+		printf("\n");
+	}
+
+	RunCachedBenchmark();
+}
@@ -0,0 +1,210 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Tests.h"
+#include "TestSupport.h"
+#include "../BoxDownscale.h"
+#include "../ResizeCache.h"
+#include "../stb_image_resize2.h"
+
+
+// Columns past the output width that must stay untouched
+#define RESIZE_TEST_PADDING 3
+
+// For whole factors the stb box filter averages the same blocks, the two may
+// only differ in rounding
+#define RESIZE_TEST_MIN_PSNR 48.0
+
+
+struct RESIZE_TEST_SIZE {
+	INT32 Width;
+	INT32 Height;
+	INT32 NewWidth;
+	INT32 NewHeight;
+};
+
+
+static const RESIZE_TEST_SIZE g_resizeTestSizes[] = {
+	{ 256, 256, 128, 128 },
+	{ 256, 256, 64, 64 },
+	{ 256, 256, 32, 32 },
+	{ 64, 64, 16, 16 },
+	{ 30, 30, 10, 10 },
+	{ 96, 48, 32, 16 },
+	{ 40, 36, 5, 6 },
+	{ 7, 9, 7, 3 },
+	{ 24, 24, 4, 4 },
+	{ 33, 33, 11, 11 },
+	{ 512, 512, 16, 16 },
+	{ 256, 256, 256, 256 }
+};
+
+
+// The exact alpha weighted average, done in doubles.
+static VOID BoxReference(const std::vector<BYTE>& input, const RESIZE_TEST_SIZE* size, std::vector<BYTE>& output) {
+	INT32 factorX = size->Width / size->NewWidth;
+	INT32 factorY = size->Height / size->NewHeight;
+	double count = (double)factorX * factorY;
+
+	output.resize((size_t)size->NewWidth * size->NewHeight * 4);
+
+	for (INT32 y = 0; y < size->NewHeight; y++) {
+		for (INT32 x = 0; x < size->NewWidth; x++) {
+			double weighted[3] = { 0.0, 0.0, 0.0 };
+			double plain[3] = { 0.0, 0.0, 0.0 };
+			double alpha = 0.0;
+
+			for (INT32 j = 0; j < factorY; j++) {
+				for (INT32 i = 0; i < factorX; i++) {
+					const BYTE* pixel = &input[((size_t)(y * factorY + j) * size->Width + x * factorX + i) * 4];
+
+					for (INT32 c = 0; c < 3; c++) {
+						weighted[c] += pixel[c] * pixel[3];
+						plain[c] += pixel[c];
+					}
+
+					alpha += pixel[3];
+				}
+			}
+
+			BYTE* result = &output[((size_t)y * size->NewWidth + x) * 4];
+
+			for (INT32 c = 0; c < 3; c++) {
+				result[c] = (BYTE)floor((alpha != 0.0 ? weighted[c] / alpha : plain[c] / count) + 0.5);
+			}
+
+			result[3] = (BYTE)floor(alpha / count + 0.5);
+		}
+	}
+}
+
+
+static VOID CheckBoxDownscale(const RESIZE_TEST_SIZE* size, INT32 kind, UINT32* seed) {
+	std::vector<BYTE> input;
+	std::vector<BYTE> expected;
+
+	MakeTestImage(kind, size->Width, size->Height, input, seed);
+	BoxReference(input, size, expected);
+
+	INT32 outputStride = (size->NewWidth + RESIZE_TEST_PADDING) * 4;
+
+	std::vector<BYTE> first;
+
+	for (INT32 i = 0; i < g_testCpuLevelCount; i++) {
+		PCTEST_CPU_LEVEL level = &g_testCpuLevels[i];
+
+		if (!SelectTestCpuLevel(level)) {
+			continue;
+		}
+
+		std::vector<BYTE> padded((size_t)outputStride * size->NewHeight, 0xCD);
+
+		HRESULT hr = BoxDownscale(input.data(), size->Width, size->Height, size->Width * 4, padded.data(), size->NewWidth, size->NewHeight, outputStride);
+		TEST_CHECK(SUCCEEDED(hr));
+
+		std::vector<BYTE> output;
+		BOOL untouched = TRUE;
+
+		for (INT32 y = 0; y < size->NewHeight; y++) {
+			const BYTE* row = &padded[(size_t)y * outputStride];
+
+			output.insert(output.end(), row, row + size->NewWidth * 4);
+
+			for (INT32 x = size->NewWidth * 4; x < outputStride; x++) {
+				untouched &= row[x] == 0xCD;
+			}
+		}
+
+		TEST_CHECK(untouched);
+
+		// Every level gives the same bytes
+		if (first.empty()) {
+			first = output;
+		}
+		else if (output != first) {
+			printf("BoxDownscale %s, %dx%d to %dx%d differs from C\n", level->Name, size->Width, size->Height, size->NewWidth, size->NewHeight);
+			TEST_CHECK(output == first);
+		}
+
+		// Within one of the exact average, the float division rounds
+		INT32 maxDifference = 0;
+
+		for (size_t j = 0; j < expected.size(); j++) {
+			maxDifference = max(maxDifference, abs((INT32)expected[j] - (INT32)output[j]));
+		}
+
+		TEST_CHECK(maxDifference <= 1);
+	}
+
+	ResetTestCpuLevel();
+
+	// Same picture as the stb box filter the provider used before
+	if (kind != TEST_IMAGE_NOISE) {
+		std::vector<BYTE> stb(expected.size());
+
+		stbir_resize(input.data(), size->Width, size->Height, size->Width * 4, stb.data(), size->NewWidth, size->NewHeight, size->NewWidth * 4,
+			STBIR_BGRA, STBIR_TYPE_UINT8, STBIR_EDGE_ZERO, STBIR_FILTER_BOX);
+
+		double psnr = GetPSNR(first, stb);
+
+		if (psnr < RESIZE_TEST_MIN_PSNR) {
+			printf("BoxDownscale %dx%d to %dx%d, %.1f dB from the stb box filter\n", size->Width, size->Height, size->NewWidth, size->NewHeight, psnr);
+		}
+
+		TEST_CHECK(psnr >= RESIZE_TEST_MIN_PSNR);
+	}
+}
+
+
+// Cached samplers give the same bytes as a one-shot resize, on the call that
+// builds them and on the next that reuses them.
+static VOID CheckCachedResize(const RESIZE_TEST_SIZE* size, stbir_pixel_layout layout, INT32 pixelSize, UINT32* seed) {
+	std::vector<BYTE> input((size_t)size->Width * size->Height * pixelSize);
+	FillRandom(input.data(), input.size(), seed);
+
+	size_t outputSize = (size_t)size->NewWidth * size->NewHeight * pixelSize;
+
+	std::vector<BYTE> expected(outputSize);
+
+	stbir_resize(input.data(), size->Width, size->Height, size->Width * pixelSize, expected.data(), size->NewWidth, size->NewHeight, size->NewWidth * pixelSize,
+		layout, STBIR_TYPE_UINT8, STBIR_EDGE_ZERO, STBIR_FILTER_DEFAULT);
+
+	for (INT32 i = 0; i < 2; i++) {
+		std::vector<BYTE> output(outputSize, 0xCD);
+
+		HRESULT hr = CachedResize(input.data(), size->Width, size->Height, size->Width * pixelSize, output.data(), size->NewWidth, size->NewHeight, size->NewWidth * pixelSize, layout);
+		TEST_CHECK(SUCCEEDED(hr));
+
+		if (output != expected) {
+			printf("CachedResize %dx%d to %dx%d, call %d differs from stbir_resize\n", size->Width, size->Height, size->NewWidth, size->NewHeight, i + 1);
+		}
+
+		TEST_CHECK(output == expected);
+	}
+}
+
+
+VOID RunResizeTests() {
+	UINT32 seed = 19;
+
+	for (INT32 i = 0; i < ARRAYSIZE(g_resizeTestSizes); i++) {
+		for (INT32 kind = TEST_IMAGE_NOISE; kind <= TEST_IMAGE_CUTOUT; kind++) {
+			CheckBoxDownscale(&g_resizeTestSizes[i], kind, &seed);
+		}
+	}
+
+	for (INT32 i = 0; i < ARRAYSIZE(g_resizeTestSizes); i++) {
+		CheckCachedResize(&g_resizeTestSizes[i], STBIR_BGRA, 4, &seed);
+		CheckCachedResize(&g_resizeTestSizes[i], STBIR_RGB, 3, &seed);
+	}
+
+	FreeResizeCache();
+
+	TEST_CHECK(!CanBoxDownscale(100, 100, 30, 30));
+	TEST_CHECK(!CanBoxDownscale(10, 10, 20, 20));
+	TEST_CHECK(CanBoxDownscale(100, 50, 50, 25));
+	TEST_CHECK(!CanBoxDownscale(4096, 4096, 16, 16));
+	TEST_CHECK(!CanBoxDownscale(MAXINT32, MAXINT32, 1, 1));
+}
@@ -0,0 +1,43 @@
+#include "TestSupport.h"
+
+// The detection of the library, with GetCpuFeatures replaced by one that
+// can be limited. The test projects build this file instead of
+// CpuFeatures.cpp.
+#define GetCpuFeatures GetDetectedCpuFeatures
+#include "../CpuFeatures.cpp"
+#undef GetCpuFeatures
+
+
+const TEST_CPU_LEVEL g_testCpuLevels[] = {
+	{ "C", 0 },
+	{ "SSE2", CPU_SSE2 },
+	{ "SSSE3", CPU_SSE2 | CPU_SSSE3 },
+	{ "SSE4.1", CPU_SSE2 | CPU_SSSE3 | CPU_SSE41 },
+	{ "AVX2", CPU_SSE2 | CPU_SSSE3 | CPU_SSE41 | CPU_AVX2 }
+};
+
+const INT32 g_testCpuLevelCount = ARRAYSIZE(g_testCpuLevels);
+
+
+static DWORD g_testFeatureMask = MAXDWORD;
+
+
+DWORD GetCpuFeatures() {
+	return GetDetectedCpuFeatures() & g_testFeatureMask;
+}
+
+
+BOOL SelectTestCpuLevel(PCTEST_CPU_LEVEL level) {
+	if ((GetDetectedCpuFeatures() & level->Features) != level->Features) {
+		return FALSE;
+	}
+
+	g_testFeatureMask = level->Features;
+
+	return TRUE;
+}
+
+
+VOID ResetTestCpuLevel() {
+	g_testFeatureMask = MAXDWORD;
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+#include "Tests.h"
+
+
+static INT32 g_checks = 0;
+static INT32 g_failures = 0;
+
+
+VOID ReportCheck(BOOL passed, const char* expression, const char* file, INT32 line) {
+	g_checks++;
+
+	if (!passed) {
+		g_failures++;
+		printf("%s(%d): check failed: %s\n", file, line, expression);
+	}
+}
+
+
+// SpriteTests [corpus directory], the corpus defaults to Corpus in the
+// working directory (the project directory under the debugger). Exits with 1
+// if any check failed.
+int wmain(int argc, wchar_t** argv) {
+	LPCWSTR corpusPath = argc > 1 ? argv[1] : L"Corpus";
+
+	RunCorruptFileTests(corpusPath);
+	RunPaletteTests();
+	RunDxtTests();
+	RunBc7Tests();
+	RunResizeTests();
+
+	printf("%d checks, %d failed\n", g_checks, g_failures);
+
+	return g_failures ? 1 : 0;
+}
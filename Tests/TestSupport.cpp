@@ -0,0 +1,417 @@
+#include <math.h>
+#include <shlwapi.h>
+#include <new>
+
+#include "TestSupport.h"
+#include "../DxtDecode.h"
+
+#pragma comment(lib, "shlwapi.lib")
+
+
+// ISequentialStream
+IFACEMETHODIMP CTestStream::Read(void* pv, ULONG cb, ULONG* pcbRead)
+{
+	ULONG cbRead = 0;
+	HRESULT hr = _pInner->Read(pv, cb, &cbRead);
+	ReadCount++;
+	BytesRead += cbRead;
+	if (pcbRead)
+	{
+		*pcbRead = cbRead;
+	}
+	return hr;
+}
+
+IFACEMETHODIMP CTestStream::Write(const void*, ULONG, ULONG*)
+{
+	return STG_E_ACCESSDENIED;
+}
+
+// IStream
+IFACEMETHODIMP CTestStream::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition)
+{
+	return _pInner->Seek(dlibMove, dwOrigin, plibNewPosition);
+}
+
+IFACEMETHODIMP CTestStream::SetSize(ULARGE_INTEGER)
+{
+	return STG_E_ACCESSDENIED;
+}
+
+IFACEMETHODIMP CTestStream::CopyTo(IStream*, ULARGE_INTEGER, ULARGE_INTEGER*, ULARGE_INTEGER*)
+{
+	return E_NOTIMPL;
+}
+
+IFACEMETHODIMP CTestStream::Commit(DWORD)
+{
+	return S_OK;
+}
+
+IFACEMETHODIMP CTestStream::Revert()
+{
+	return S_OK;
+}
+
+IFACEMETHODIMP CTestStream::LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD)
+{
+	return STG_E_INVALIDFUNCTION;
+}
+
+IFACEMETHODIMP CTestStream::UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD)
+{
+	return STG_E_INVALIDFUNCTION;
+}
+
+IFACEMETHODIMP CTestStream::Stat(STATSTG* pstatstg, DWORD grfStatFlag)
+{
+	if (_dwFlags & TEST_STREAM_NO_STAT)
+	{
+		return E_NOTIMPL;
+	}
+	return _pInner->Stat(pstatstg, grfStatFlag);
+}
+
+IFACEMETHODIMP CTestStream::Clone(IStream** ppstm)
+{
+	*ppstm = NULL;
+	return E_NOTIMPL;
+}
+
+
+static HRESULT WrapTestStream(IStream* inner, DWORD flags, PTEST_STREAM* result) {
+	PTEST_STREAM stream = new (std::nothrow) CTestStream(inner, flags);
+
+	inner->Release();
+
+	if (stream == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	*result = stream;
+
+	return S_OK;
+}
+
+
+HRESULT CreateTestStream(const BYTE* data, ULONG size, DWORD flags, PTEST_STREAM* result) {
+	IStream* inner = SHCreateMemStream(data, size);
+
+	if (inner == NULL) {
+		return E_OUTOFMEMORY;
+	}
+
+	return WrapTestStream(inner, flags, result);
+}
+
+
+HRESULT OpenTestStream(LPCWSTR path, DWORD flags, PTEST_STREAM* result) {
+	IStream* inner;
+
+	HRESULT hr = SHCreateStreamOnFileEx(path, STGM_READ | STGM_SHARE_DENY_WRITE, FILE_ATTRIBUTE_NORMAL, FALSE, NULL, &inner);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	return WrapTestStream(inner, flags, result);
+}
+
+
+UINT32 NextRandom(UINT32* seed) {
+	*seed = *seed * 1664525 + 1013904223;
+
+	return *seed >> 8;
+}
+
+
+VOID FillRandom(BYTE* data, size_t size, UINT32* seed) {
+	for (size_t i = 0; i < size; i++) {
+		data[i] = (BYTE)NextRandom(seed);
+	}
+}
+
+
+static VOID AppendInt32(std::vector<BYTE>& data, INT32 value) {
+	BYTE* bytes = (BYTE*)&value;
+
+	data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+
+static VOID AppendFloat(std::vector<BYTE>& data, float value) {
+	BYTE* bytes = (BYTE*)&value;
+
+	data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+
+static VOID AppendRandom(std::vector<BYTE>& data, size_t size, UINT32* seed) {
+	size_t start = data.size();
+
+	data.resize(start + size);
+
+	FillRandom(data.data() + start, size, seed);
+}
+
+
+static VOID AppendSpriteHeader(std::vector<BYTE>& data, INT32 version, INT32 frameCount, INT32 width, INT32 height) {
+	AppendInt32(data, 0x50534449); // IDSP
+	AppendInt32(data, version);
+	AppendInt32(data, 2);          // Type
+	AppendInt32(data, 0);          // TexFormat
+	AppendFloat(data, 1.0f);       // BoundingRadius
+	AppendInt32(data, width);
+	AppendInt32(data, height);
+	AppendInt32(data, frameCount);
+	AppendFloat(data, 0.0f);       // BeamLength
+	AppendInt32(data, 0);          // SyncType
+}
+
+
+VOID WriteSpriteV2(std::vector<BYTE>& data, INT32 frameCount, INT32 width, INT32 height, UINT32* seed) {
+	AppendSpriteHeader(data, 2, frameCount, width, height);
+
+	data.push_back(0);
+	data.push_back(1); // 256 colors
+
+	AppendRandom(data, 256 * 3, seed);
+
+	for (INT32 i = 0; i < frameCount; i++) {
+		AppendInt32(data, 0); // SPR_SINGLE
+		AppendInt32(data, -width / 2);
+		AppendInt32(data, height / 2);
+		AppendInt32(data, width);
+		AppendInt32(data, height);
+
+		AppendRandom(data, (size_t)width * height, seed);
+	}
+}
+
+
+VOID WriteSpriteV3(std::vector<BYTE>& data, INT32 frameCount, INT32 width, INT32 height, DWORD format, INT32 mipCount, UINT32* seed) {
+	AppendSpriteHeader(data, 3, frameCount, width, height);
+
+	for (INT32 i = 0; i < frameCount; i++) {
+		AppendInt32(data, 0x20534444); // DDS
+		AppendInt32(data, 124);        // dwSize
+		AppendInt32(data, 0x21007);    // CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT
+		AppendInt32(data, height);
+		AppendInt32(data, width);
+		AppendInt32(data, 0);          // dwPitchOrLinearSize
+		AppendInt32(data, 0);          // dwDepth
+		AppendInt32(data, mipCount);
+
+		for (INT32 j = 0; j < 11; j++) {
+			AppendInt32(data, 0);
+		}
+
+		AppendInt32(data, 32);         // ddspf.dwSize
+		AppendInt32(data, 0x4);        // DDPF_FOURCC
+		AppendInt32(data, (INT32)format);
+
+		for (INT32 j = 0; j < 5; j++) {
+			AppendInt32(data, 0);
+		}
+
+		AppendInt32(data, 0x1000);     // DDSCAPS_TEXTURE
+
+		for (INT32 j = 0; j < 4; j++) {
+			AppendInt32(data, 0);
+		}
+
+		for (INT32 level = 0; level < mipCount; level++) {
+			INT32 levelWidth = max(1, width >> level);
+			INT32 levelHeight = max(1, height >> level);
+
+			AppendRandom(data, (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * GetDXTBlockSize(format), seed);
+		}
+	}
+}
+
+
+static HRESULT WriteTestFile(LPCWSTR path, const std::vector<BYTE>& data) {
+	HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	DWORD written;
+	HRESULT hr = S_OK;
+
+	if (!WriteFile(file, data.data(), (DWORD)data.size(), &written, NULL) || written != data.size()) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	CloseHandle(file);
+
+	return hr;
+}
+
+
+// One sprite of the corpus, v2 files of 1 to 8 frames and v3 DXT1 and DXT5
+// files, from icons to a few hundred pixels wide.
+static VOID WriteCorpusSprite(std::vector<BYTE>& data, INT32 index, UINT32* seed) {
+	INT32 width = 16 << (NextRandom(seed) % 5);
+	INT32 height = 16 << (NextRandom(seed) % 5);
+
+	switch (index % 4) {
+		case 0:
+		case 1: {
+			WriteSpriteV2(data, 1 + NextRandom(seed) % 8, width, height, seed);
+			break;
+		}
+		case 2: {
+			WriteSpriteV3(data, 1, width, height, DXT_FORMAT_DXT1, 1, seed);
+			break;
+		}
+		case 3: {
+			WriteSpriteV3(data, 1 + NextRandom(seed) % 4, width, height, DXT_FORMAT_DXT5, 1, seed);
+			break;
+		}
+	}
+}
+
+
+HRESULT WriteTestCorpus(INT32 fileCount, TEST_CORPUS* corpus, UINT32* seed) {
+	WCHAR path[MAX_PATH];
+
+	DWORD length = GetTempPathW(ARRAYSIZE(path), path);
+	if (length == 0 || length >= ARRAYSIZE(path)) {
+		return E_FAIL;
+	}
+
+	swprintf_s(path + length, ARRAYSIZE(path) - length, L"SpriteCorpus%u", GetCurrentProcessId());
+
+	if (!CreateDirectoryW(path, NULL)) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	corpus->Root = path;
+	corpus->TotalBytes = 0;
+
+	std::vector<BYTE> data;
+
+	for (INT32 i = 0; i < fileCount; i++) {
+		if (i % TEST_CORPUS_DIRECTORY_FILES == 0) {
+			swprintf_s(path, ARRAYSIZE(path), L"%ls\\%03d", corpus->Root.c_str(), i / TEST_CORPUS_DIRECTORY_FILES);
+
+			if (!CreateDirectoryW(path, NULL)) {
+				HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+				DeleteTestCorpus(corpus);
+				return hr;
+			}
+
+			corpus->Directories.push_back(path);
+		}
+
+		swprintf_s(path, ARRAYSIZE(path), L"%ls\\%05d.spr", corpus->Directories.back().c_str(), i);
+
+		data.clear();
+		WriteCorpusSprite(data, i, seed);
+
+		HRESULT hr = WriteTestFile(path, data);
+		if (FAILED(hr)) {
+			DeleteTestCorpus(corpus);
+			return hr;
+		}
+
+		corpus->Paths.push_back(path);
+		corpus->TotalBytes += data.size();
+	}
+
+	return S_OK;
+}
+
+
+VOID DeleteTestCorpus(TEST_CORPUS* corpus) {
+	for (size_t i = 0; i < corpus->Paths.size(); i++) {
+		DeleteFileW(corpus->Paths[i].c_str());
+	}
+
+	for (size_t i = 0; i < corpus->Directories.size(); i++) {
+		RemoveDirectoryW(corpus->Directories[i].c_str());
+	}
+
+	if (!corpus->Root.empty()) {
+		RemoveDirectoryW(corpus->Root.c_str());
+	}
+
+	corpus->Root.clear();
+	corpus->Directories.clear();
+	corpus->Paths.clear();
+}
+
+
+HRESULT ReadTestImageRows(PSPRITE_IMAGE image) {
+	INT32 bandRows = GetSpriteImageBandRows(image);
+
+	for (INT32 y = 0; y < image->Height; y += bandRows) {
+		const BYTE* rows;
+
+		HRESULT hr = ReadSpriteImageRows(image, y, min(bandRows, image->Height - y), &rows);
+		if (FAILED(hr)) {
+			return hr;
+		}
+	}
+
+	return S_OK;
+}
+
+
+VOID MakeTestImage(INT32 kind, INT32 width, INT32 height, std::vector<BYTE>& pixels, UINT32* seed) {
+	pixels.resize((size_t)width * height * 4);
+
+	if (kind == TEST_IMAGE_NOISE) {
+		FillRandom(pixels.data(), pixels.size(), seed);
+		return;
+	}
+
+	for (INT32 y = 0; y < height; y++) {
+		for (INT32 x = 0; x < width; x++) {
+			BYTE* pixel = &pixels[((size_t)y * width + x) * 4];
+
+			pixel[0] = (BYTE)(x * 255 / width);
+			pixel[1] = (BYTE)(y * 255 / height);
+			pixel[2] = ((x ^ y) & 16) ? 200 : 40;
+			pixel[3] = kind == TEST_IMAGE_CUTOUT && ((x / 8 + y / 8) & 1) ? 0 : 255;
+		}
+	}
+}
+
+
+double GetPSNR(const std::vector<BYTE>& a, const std::vector<BYTE>& b) {
+	double error = 0.0;
+
+	for (size_t i = 0; i < a.size(); i += 4) {
+		for (size_t c = 0; c < 4; c++) {
+			double difference = c == 3 ? (double)a[i + 3] - (double)b[i + 3] :
+				((double)a[i + c] * a[i + 3] - (double)b[i + c] * b[i + 3]) / 255.0;
+
+			error += difference * difference;
+		}
+	}
+
+	if (error == 0.0) {
+		return 99.0;
+	}
+
+	return 10.0 * log10(255.0 * 255.0 * a.size() / error);
+}
+
+
+LONGLONG GetTimestamp() {
+	LARGE_INTEGER counter;
+
+	QueryPerformanceCounter(&counter);
+
+	return counter.QuadPart;
+}
+
+
+double GetElapsedSeconds(LONGLONG start) {
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceFrequency(&frequency);
+
+	return (double)(GetTimestamp() - start) / (double)frequency.QuadPart;
+}
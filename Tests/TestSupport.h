@@ -0,0 +1,168 @@
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+#include "../SpriteLoader.h"
+
+
+enum {
+	TEST_STREAM_NO_STAT = 0x1 // Stat fails like a pipe or network stream would
+};
+
+
+// Stream over another stream that counts what the loaders read from it.
+class CTestStream : public IStream
+{
+public:
+	CTestStream(IStream* pInner, DWORD dwFlags)
+		: _cRef(1)
+		, _pInner(pInner)
+		, _dwFlags(dwFlags)
+		, ReadCount(0)
+		, BytesRead(0)
+	{
+		_pInner->AddRef();
+	}
+
+	virtual ~CTestStream()
+	{
+		_pInner->Release();
+	}
+
+	// IUnknown
+	IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv)
+	{
+		if (riid == IID_IUnknown || riid == IID_ISequentialStream || riid == IID_IStream)
+		{
+			*ppv = static_cast<IStream*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+
+	IFACEMETHODIMP_(ULONG) AddRef()
+	{
+		return InterlockedIncrement(&_cRef);
+	}
+
+	IFACEMETHODIMP_(ULONG) Release()
+	{
+		ULONG cRef = InterlockedDecrement(&_cRef);
+		if (!cRef)
+		{
+			delete this;
+		}
+		return cRef;
+	}
+
+	// ISequentialStream
+	IFACEMETHODIMP Read(void* pv, ULONG cb, ULONG* pcbRead);
+	IFACEMETHODIMP Write(const void* pv, ULONG cb, ULONG* pcbWritten);
+
+	// IStream
+	IFACEMETHODIMP Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition);
+	IFACEMETHODIMP SetSize(ULARGE_INTEGER libNewSize);
+	IFACEMETHODIMP CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten);
+	IFACEMETHODIMP Commit(DWORD grfCommitFlags);
+	IFACEMETHODIMP Revert();
+	IFACEMETHODIMP LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+	IFACEMETHODIMP UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+	IFACEMETHODIMP Stat(STATSTG* pstatstg, DWORD grfStatFlag);
+	IFACEMETHODIMP Clone(IStream** ppstm);
+
+	// Read calls and bytes returned since creation
+	ULONG ReadCount;
+	ULONGLONG BytesRead;
+
+private:
+	long _cRef;
+	IStream* _pInner;
+	DWORD _dwFlags;
+};
+
+typedef CTestStream* PTEST_STREAM;
+
+
+// Test streams over a copy of the data or over a file, read only.
+HRESULT CreateTestStream(const BYTE* data, ULONG size, DWORD flags, PTEST_STREAM* result);
+HRESULT OpenTestStream(LPCWSTR path, DWORD flags, PTEST_STREAM* result);
+
+
+// Instruction set levels the kernels dispatch on, from plain C up to AVX2.
+struct TEST_CPU_LEVEL {
+	const char* Name;
+	DWORD Features;
+};
+
+typedef const TEST_CPU_LEVEL* PCTEST_CPU_LEVEL;
+
+extern const TEST_CPU_LEVEL g_testCpuLevels[];
+extern const INT32 g_testCpuLevelCount;
+
+// Limits GetCpuFeatures to the features of the level, so every kernel can be
+// run on one machine. FALSE if the CPU lacks them.
+BOOL SelectTestCpuLevel(PCTEST_CPU_LEVEL level);
+
+// Back to the detected features.
+VOID ResetTestCpuLevel();
+
+
+// Linear congruential generator, the same sequence on every run.
+UINT32 NextRandom(UINT32* seed);
+VOID FillRandom(BYTE* data, size_t size, UINT32* seed);
+
+
+// Appends a v2 sprite of frameCount single frames of random indices with a
+// full 256 color palette.
+VOID WriteSpriteV2(std::vector<BYTE>& data, INT32 frameCount, INT32 width, INT32 height, UINT32* seed);
+
+// Appends a v3 sprite of frameCount frames of random blocks with mipCount
+// levels each, format is one of the DXT_FORMAT FourCCs.
+VOID WriteSpriteV3(std::vector<BYTE>& data, INT32 frameCount, INT32 width, INT32 height, DWORD format, INT32 mipCount, UINT32* seed);
+
+
+// Generated sprites of both versions and a few sizes, written to
+// subdirectories of TEST_CORPUS_DIRECTORY_FILES files each under a new
+// directory in the temp folder.
+#define TEST_CORPUS_DIRECTORY_FILES 100
+
+struct TEST_CORPUS {
+	std::wstring Root;
+	std::vector<std::wstring> Directories;
+	std::vector<std::wstring> Paths;
+	ULONGLONG TotalBytes;
+};
+
+HRESULT WriteTestCorpus(INT32 fileCount, TEST_CORPUS* corpus, UINT32* seed);
+
+// Deletes the files and directories of the corpus.
+VOID DeleteTestCorpus(TEST_CORPUS* corpus);
+
+
+// Reads every row of the image a band at a time, like the thumbnail
+// provider does.
+HRESULT ReadTestImageRows(PSPRITE_IMAGE image);
+
+
+enum {
+	TEST_IMAGE_NOISE = 0, // random colors and alpha
+	TEST_IMAGE_GRADIENT,  // smooth colors with hard stripes, opaque
+	TEST_IMAGE_CUTOUT     // the gradient behind a checkerboard of holes
+};
+
+// width x height B, G, R, A pixels of one of the above.
+VOID MakeTestImage(INT32 kind, INT32 width, INT32 height, std::vector<BYTE>& pixels, UINT32* seed);
+
+// Peak signal to noise ratio of two B, G, R, A images of the same size in
+// dB, 99 if they are identical. Colors are compared premultiplied, what is
+// under transparent pixels does not count.
+double GetPSNR(const std::vector<BYTE>& a, const std::vector<BYTE>& b);
+
+
+// Performance counter ticks, and the seconds elapsed since such a tick.
+LONGLONG GetTimestamp();
+double GetElapsedSeconds(LONGLONG start);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Windows.h>
+
+
+// Counts one check, failures are printed with the expression and location.
+VOID ReportCheck(BOOL passed, const char* expression, const char* file, INT32 line);
+
+#define TEST_CHECK(condition) ReportCheck((condition) ? TRUE : FALSE, #condition, __FILE__, __LINE__)
+
+
+// Test groups, run in this order by wmain.
+VOID RunCorruptFileTests(LPCWSTR corpusPath);
+VOID RunPaletteTests();
+VOID RunDxtTests();
+VOID RunBc7Tests();
+VOID RunResizeTests();
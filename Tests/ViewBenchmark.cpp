@@ -0,0 +1,187 @@
+#include <stdio.h>
+
+#include "Benchmarks.h"
+#include "TestSupport.h"
+#include "../DxtDecode.h"
+#include "../SpriteFile.h"
+#include "../SpriteFileV3.h"
+#include "../SpriteView.h"
+
+
+#define VIEW_BENCHMARK_FILES 4000
+
+// The views touch one byte per page so the mapping is read in as well
+#define VIEW_BENCHMARK_PAGE 4096
+
+
+struct VIEW_BENCHMARK {
+	const TEST_CORPUS* Corpus;
+	BOOL TouchPixels;
+	INT32 Failed;
+	UINT32 Checksum;
+};
+
+
+static HRESULT LoadWithStream(LPCWSTR path) {
+	PTEST_STREAM stream;
+
+	HRESULT hr = OpenTestStream(path, 0, &stream);
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	STREAM_READER reader;
+	InitStreamReader(&reader, stream);
+
+	INT32 id, version;
+
+	hr = ReadInt32(&reader, &id);
+	if (SUCCEEDED(hr)) {
+		hr = ReadInt32(&reader, &version);
+	}
+	if (SUCCEEDED(hr)) {
+		hr = SeekReader(&reader, 0);
+	}
+
+	if (SUCCEEDED(hr)) {
+		if (version == 3) {
+			PSPRITE_FILE_V3 sprite;
+
+			hr = LoadSpriteFileV3(&reader, &sprite);
+			if (SUCCEEDED(hr)) {
+				FreeSpriteFileV3(sprite);
+			}
+		}
+		else {
+			PSPRITE_FILE sprite;
+
+			hr = LoadSpriteFile(&reader, &sprite);
+			if (SUCCEEDED(hr)) {
+				FreeSpriteFile(sprite);
+			}
+		}
+	}
+
+	stream->Release();
+
+	return hr;
+}
+
+
+static UINT32 TouchPages(const BYTE* data, size_t size) {
+	UINT32 sum = 0;
+
+	for (size_t i = 0; i < size; i += VIEW_BENCHMARK_PAGE) {
+		sum += data[i];
+	}
+
+	return sum;
+}
+
+
+static UINT32 TouchViewPixels(PSPRITE_VIEW view) {
+	UINT32 sum = 0;
+
+	for (INT32 i = 0; i < view->FrameCount; i++) {
+		if (view->Version == 3) {
+			PSPRITE_FRAME_V3 frame = &view->FramesV3[i];
+			size_t size = 0;
+
+			for (INT32 level = 0; level < frame->Header.MipCount; level++) {
+				INT32 width = max(1, frame->Header.Width >> level);
+				INT32 height = max(1, frame->Header.Height >> level);
+
+				size += (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetDXTBlockSize(frame->Header.Format);
+			}
+
+			sum += TouchPages(frame->Pixels, size);
+		}
+		else {
+			PSPRITE_FRAME_SINGLE frame = &view->Frames[i];
+
+			sum += TouchPages(frame->Pixels, (size_t)frame->Header.Width * frame->Header.Height);
+		}
+	}
+
+	return sum;
+}
+
+
+static VOID RunStreamLoads(PVOID context) {
+	VIEW_BENCHMARK* benchmark = (VIEW_BENCHMARK*)context;
+
+	for (size_t i = 0; i < benchmark->Corpus->Paths.size(); i++) {
+		if (FAILED(LoadWithStream(benchmark->Corpus->Paths[i].c_str()))) {
+			benchmark->Failed++;
+		}
+	}
+}
+
+
+static VOID RunViews(PVOID context) {
+	VIEW_BENCHMARK* benchmark = (VIEW_BENCHMARK*)context;
+
+	for (size_t i = 0; i < benchmark->Corpus->Paths.size(); i++) {
+		PSPRITE_VIEW view;
+
+		if (FAILED(OpenSpriteView(benchmark->Corpus->Paths[i].c_str(), &view))) {
+			benchmark->Failed++;
+			continue;
+		}
+
+		if (benchmark->TouchPixels) {
+			benchmark->Checksum += TouchViewPixels(view);
+		}
+
+		CloseSpriteView(view);
+	}
+}
+
+
+// Mapped views against the stream loaders over a generated corpus of a few
+// thousand files in the temp folder. The stream loaders copy every frame out
+// of the file, the views only validate it, or also touch each page of the
+// pixels once. The files stay in the system cache after the first pass.
+VOID RunViewBenchmark() {
+	UINT32 seed = 5;
+
+	TEST_CORPUS corpus;
+
+	HRESULT hr = WriteTestCorpus(VIEW_BENCHMARK_FILES, &corpus, &seed);
+	if (FAILED(hr)) {
+		printf("cannot write the corpus, 0x%08X\n", (UINT32)hr);
+		return;
+	}
+
+	printf("%u files, %.1f MiB\n", (UINT32)corpus.Paths.size(), corpus.TotalBytes / (1024.0 * 1024.0));
+	printf("%-16s %12s %12s\n", "loader", "files/s", "MiB/s");
+
+	struct VIEW_BENCHMARK_RUN {
+		const char* Name;
+		VOID (*Run)(PVOID context);
+		BOOL TouchPixels;
+	};
+
+	static const VIEW_BENCHMARK_RUN runs[] = {
+		{ "stream", RunStreamLoads, FALSE },
+		{ "view", RunViews, FALSE },
+		{ "view + pages", RunViews, TRUE }
+	};
+
+	for (INT32 i = 0; i < ARRAYSIZE(runs); i++) {
+		VIEW_BENCHMARK benchmark = {};
+		benchmark.Corpus = &corpus;
+		benchmark.TouchPixels = runs[i].TouchPixels;
+
+		double seconds = TimeBenchmark(runs[i].Run, &benchmark);
+
+		if (benchmark.Failed != 0) {
+			printf("%-16s %d loads failed\n", runs[i].Name, benchmark.Failed);
+			continue;
+		}
+
+		printf("%-16s %12.0f %12.1f\n", runs[i].Name, corpus.Paths.size() / seconds, corpus.TotalBytes / seconds / (1024.0 * 1024.0));
+	}
+
+	DeleteTestCorpus(&corpus);
+}
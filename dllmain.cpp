@@ -10,6 +10,7 @@
 #include <thumbcache.h> // For IThumbnailProvider.
 #include <shlobj.h>     // For SHChangeNotify
 #include <new>
+#include "ResizeCache.h"
 
 extern HRESULT CSpriteThumbProvider_CreateInstance(REFIID riid, void** ppv);
 
@@ -38,13 +39,18 @@ long g_cRefModule = 0;
 HINSTANCE g_hInst = NULL;
 
 // Standard DLL functions
-STDAPI_(BOOL) DllMain(HINSTANCE hInstance, DWORD dwReason, void*)
+STDAPI_(BOOL) DllMain(HINSTANCE hInstance, DWORD dwReason, void* pvReserved)
 {
 	if (dwReason == DLL_PROCESS_ATTACH)
 	{
 		g_hInst = hInstance;
 		DisableThreadLibraryCalls(hInstance);
 	}
+	else if (dwReason == DLL_PROCESS_DETACH && pvReserved == NULL)
+	{
+		// Unloaded through FreeLibrary, not at process exit where the heap is torn down anyway
+		FreeResizeCache();
+	}
 	return TRUE;
 }
 
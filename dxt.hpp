@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -12,56 +13,253 @@ typedef struct {
 #pragma pack(pop)
 
 
-static void DecompressDXT5(uint8_t* input, int width, int height, RGB24* output) {
+// Output rows are stride bytes apart, texels past width or height are dropped.
+
+static void DecodeDXTColorTable(const uint8_t* block, RGB24 colorTable[4]) {
+    uint16_t color0 = *(uint16_t*)(block + 0);
+    uint16_t color1 = *(uint16_t*)(block + 2);
+
+    colorTable[0].r = ((color0 >> 11) & 0x1F) * 255 / 31;
+    colorTable[0].g = ((color0 >> 5) & 0x3F) * 255 / 63;
+    colorTable[0].b = (color0 & 0x1F) * 255 / 31;
+
+    colorTable[1].r = ((color1 >> 11) & 0x1F) * 255 / 31;
+    colorTable[1].g = ((color1 >> 5) & 0x3F) * 255 / 63;
+    colorTable[1].b = (color1 & 0x1F) * 255 / 31;
+
+    if (color0 > color1) {
+        colorTable[2].r = (2 * colorTable[0].r + colorTable[1].r) / 3;
+        colorTable[2].g = (2 * colorTable[0].g + colorTable[1].g) / 3;
+        colorTable[2].b = (2 * colorTable[0].b + colorTable[1].b) / 3;
+
+        colorTable[3].r = (colorTable[0].r + 2 * colorTable[1].r) / 3;
+        colorTable[3].g = (colorTable[0].g + 2 * colorTable[1].g) / 3;
+        colorTable[3].b = (colorTable[0].b + 2 * colorTable[1].b) / 3;
+    }
+    else {
+        colorTable[2].r = (colorTable[0].r + colorTable[1].r) / 2;
+        colorTable[2].g = (colorTable[0].g + colorTable[1].g) / 2;
+        colorTable[2].b = (colorTable[0].b + colorTable[1].b) / 2;
+
+        colorTable[3].r = 0;
+        colorTable[3].g = 0;
+        colorTable[3].b = 0;
+    }
+}
+
+
+// Interpolated 8-bit alpha, 8 (a0 > a1) or 6 steps plus 0 and 255.
+static void DecodeDXTAlphaTable(const uint8_t* block, uint8_t alphaTable[8]) {
+    int alpha0 = block[0];
+    int alpha1 = block[1];
+
+    alphaTable[0] = alpha0;
+    alphaTable[1] = alpha1;
+
+    if (alpha0 > alpha1) {
+        for (int i = 1; i < 7; i++) {
+            alphaTable[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+        }
+    }
+    else {
+        for (int i = 1; i < 5; i++) {
+            alphaTable[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+        }
+
+        alphaTable[6] = 0;
+        alphaTable[7] = 255;
+    }
+}
+
+
+// Color only decode for any block layout, the 8 byte color block is at the
+// end of each block (blockSize 8 for DXT1, 16 for DXT3 and DXT5).
+static void DecompressDXTColors(uint8_t* input, int blockSize, int width, int height, RGB24* output, size_t stride) {
     int blocksX = (width + 3) / 4;
     int blocksY = (height + 3) / 4;
 
     for (int blockY = 0; blockY < blocksY; blockY++) {
         for (int blockX = 0; blockX < blocksX; blockX++) {
-            uint8_t* block = input + (blockY * blocksX + blockX) * 16;
+            uint8_t* block = input + (blockY * blocksX + blockX) * blockSize;
 
             // Decompress color channels
-            uint16_t color0 = *(uint16_t*)(block + 8);
-            uint16_t color1 = *(uint16_t*)(block + 10);
-            uint32_t colorBits = *(uint32_t*)(block + 12);
-
             RGB24 colorTable[4];
-            colorTable[0].r = ((color0 >> 11) & 0x1F) * 255 / 31;
-            colorTable[0].g = ((color0 >> 5) & 0x3F) * 255 / 63;
-            colorTable[0].b = (color0 & 0x1F) * 255 / 31;
-
-            colorTable[1].r = ((color1 >> 11) & 0x1F) * 255 / 31;
-            colorTable[1].g = ((color1 >> 5) & 0x3F) * 255 / 63;
-            colorTable[1].b = (color1 & 0x1F) * 255 / 31;
-
-            if (color0 > color1) {
-                colorTable[2].r = (2 * colorTable[0].r + colorTable[1].r) / 3;
-                colorTable[2].g = (2 * colorTable[0].g + colorTable[1].g) / 3;
-                colorTable[2].b = (2 * colorTable[0].b + colorTable[1].b) / 3;
-
-                colorTable[3].r = (colorTable[0].r + 2 * colorTable[1].r) / 3;
-                colorTable[3].g = (colorTable[0].g + 2 * colorTable[1].g) / 3;
-                colorTable[3].b = (colorTable[0].b + 2 * colorTable[1].b) / 3;
-            }
-            else {
-                colorTable[2].r = (colorTable[0].r + colorTable[1].r) / 2;
-                colorTable[2].g = (colorTable[0].g + colorTable[1].g) / 2;
-                colorTable[2].b = (colorTable[0].b + colorTable[1].b) / 2;
-
-                colorTable[3].r = 0;
-                colorTable[3].g = 0;
-                colorTable[3].b = 0;
-            }
+            DecodeDXTColorTable(block + blockSize - 8, colorTable);
+
+            uint32_t colorBits = *(uint32_t*)(block + blockSize - 4);
 
             // Write to output
             for (int i = 0; i < 16; i++) {
                 int pixelX = blockX * 4 + (i % 4);
                 int pixelY = blockY * 4 + (i / 4);
-                int pixelIndex = pixelY * width + pixelX;
+
+                if (pixelX >= width || pixelY >= height) {
+                    continue;
+                }
+
+                RGB24* pixel = (RGB24*)((uint8_t*)output + pixelY * stride) + pixelX;
 
                 uint8_t code = (colorBits >> (2 * i)) & 0x03;
-                output[pixelIndex] = colorTable[code];
+                *pixel = colorTable[code];
             }
         }
     }
 }
+
+
+static void DecompressDXT5(uint8_t* input, int width, int height, RGB24* output, size_t stride) {
+    DecompressDXTColors(input, 16, width, height, output, stride);
+}
+
+
+// Block decoders, 16 pixels of 32-bit B, G, R, A in row order.
+
+static void DecodeDXTColorBlock(const uint8_t* block, uint32_t colors[4]) {
+    RGB24 colorTable[4];
+    DecodeDXTColorTable(block, colorTable);
+
+    for (int i = 0; i < 4; i++) {
+        colors[i] = colorTable[i].b | (colorTable[i].g << 8) | (colorTable[i].r << 16);
+    }
+}
+
+
+// DXT1 (BC1), 1-bit alpha: in the three color mode code 3 is transparent.
+static void DecodeDXT1Block(const uint8_t* block, uint32_t pixels[16]) {
+    uint32_t colors[4];
+    DecodeDXTColorBlock(block, colors);
+
+    uint16_t color0 = *(uint16_t*)(block + 0);
+    uint16_t color1 = *(uint16_t*)(block + 2);
+
+    colors[0] |= 0xFF000000;
+    colors[1] |= 0xFF000000;
+    colors[2] |= 0xFF000000;
+
+    if (color0 > color1) {
+        colors[3] |= 0xFF000000;
+    }
+
+    uint32_t colorBits = *(uint32_t*)(block + 4);
+
+    for (int i = 0; i < 16; i++) {
+        pixels[i] = colors[(colorBits >> (2 * i)) & 0x03];
+    }
+}
+
+
+// DXT3 (BC2), explicit 4-bit alpha in bytes 0-7.
+static void DecodeDXT3Block(const uint8_t* block, uint32_t pixels[16]) {
+    uint32_t colors[4];
+    DecodeDXTColorBlock(block + 8, colors);
+
+    uint32_t colorBits = *(uint32_t*)(block + 12);
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t alpha = (block[i / 2] >> (4 * (i % 2))) & 0x0F;
+        pixels[i] = colors[(colorBits >> (2 * i)) & 0x03] | ((alpha * 17) << 24);
+    }
+}
+
+
+// The 16 values of an 8 byte interpolated block, the DXT5 alpha block and
+// the channel blocks of BC4 and BC5. 3-bit indices are in bytes 2-7.
+static void DecodeDXTAlphaValues(const uint8_t* block, uint8_t values[16]) {
+    uint8_t alphaTable[8];
+    DecodeDXTAlphaTable(block, alphaTable);
+
+    uint64_t alphaBits = 0;
+    for (int i = 0; i < 6; i++) {
+        alphaBits |= (uint64_t)block[2 + i] << (8 * i);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        values[i] = alphaTable[(alphaBits >> (3 * i)) & 0x07];
+    }
+}
+
+
+// DXT5 (BC3), interpolated alpha.
+static void DecodeDXT5Block(const uint8_t* block, uint32_t pixels[16]) {
+    uint32_t colors[4];
+    DecodeDXTColorBlock(block + 8, colors);
+
+    uint32_t colorBits = *(uint32_t*)(block + 12);
+
+    uint8_t alphas[16];
+    DecodeDXTAlphaValues(block, alphas);
+
+    for (int i = 0; i < 16; i++) {
+        uint8_t code = (colorBits >> (2 * i)) & 0x03;
+        pixels[i] = colors[code] | ((uint32_t)alphas[i] << 24);
+    }
+}
+
+
+// BC4, a single channel shown as opaque gray.
+static void DecodeBC4Block(const uint8_t* block, uint32_t pixels[16]) {
+    uint8_t values[16];
+    DecodeDXTAlphaValues(block, values);
+
+    for (int i = 0; i < 16; i++) {
+        pixels[i] = values[i] * 0x010101u | 0xFF000000;
+    }
+}
+
+
+// BC5, red and green channels (usually a normal map), blue stays 0.
+static void DecodeBC5Block(const uint8_t* block, uint32_t pixels[16]) {
+    uint8_t reds[16];
+    uint8_t greens[16];
+    DecodeDXTAlphaValues(block, reds);
+    DecodeDXTAlphaValues(block + 8, greens);
+
+    for (int i = 0; i < 16; i++) {
+        pixels[i] = ((uint32_t)greens[i] << 8) | ((uint32_t)reds[i] << 16) | 0xFF000000;
+    }
+}
+
+
+typedef void (*DXT_BLOCK_DECODER)(const uint8_t* block, uint32_t pixels[16]);
+
+static void DecompressDXTBGRA(uint8_t* input, int blockSize, DXT_BLOCK_DECODER decodeBlock, int width, int height, uint32_t* output, size_t stride) {
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+
+    for (int blockY = 0; blockY < blocksY; blockY++) {
+        for (int blockX = 0; blockX < blocksX; blockX++) {
+            uint8_t* block = input + (blockY * blocksX + blockX) * blockSize;
+
+            uint32_t pixels[16];
+            decodeBlock(block, pixels);
+
+            // Write to output
+            for (int i = 0; i < 16; i++) {
+                int pixelX = blockX * 4 + (i % 4);
+                int pixelY = blockY * 4 + (i / 4);
+
+                if (pixelX >= width || pixelY >= height) {
+                    continue;
+                }
+
+                uint32_t* pixel = (uint32_t*)((uint8_t*)output + pixelY * stride) + pixelX;
+                *pixel = pixels[i];
+            }
+        }
+    }
+}
+
+
+static void DecompressDXT1BGRA(uint8_t* input, int width, int height, uint32_t* output, size_t stride) {
+    DecompressDXTBGRA(input, 8, DecodeDXT1Block, width, height, output, stride);
+}
+
+
+static void DecompressDXT3BGRA(uint8_t* input, int width, int height, uint32_t* output, size_t stride) {
+    DecompressDXTBGRA(input, 16, DecodeDXT3Block, width, height, output, stride);
+}
+
+
+static void DecompressDXT5BGRA(uint8_t* input, int width, int height, uint32_t* output, size_t stride) {
+    DecompressDXTBGRA(input, 16, DecodeDXT5Block, width, height, output, stride);
+}